@@ -0,0 +1,341 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "BaseLexer.h"
+#include <Scintilla.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void SCI_METHOD BaseLexer::Lex(unsigned int startPos, int lengthDoc, int initStyle, IDocument *doc)
+{
+	if (doc->Length() != _knownLength)
+	{
+		//Missed some changes, they will be after the first unstyled line
+		int line = doc->LineFromPosition((int)startPos);
+		_changedFrom = _changedFrom < _changedTo ? std::min(_changedFrom, line) : line;
+		_changedTo = INT_MAX;
+		_knownLength = doc->Length();
+		//The lines may have moved, so extended states can not be trusted
+		_extendedStates.clear();
+		++_version;
+		if (_thread) _thread->cancel();
+	}
+
+	//Always finish on a line end, so the next Lex can start on a line
+	unsigned end = startPos + (unsigned)lengthDoc;
+	if (end > startPos) end = (unsigned)doc->LineStart(doc->LineFromPosition((int)end - 1) + 1);
+	if (end > (unsigned)doc->Length()) end = (unsigned)doc->Length();
+
+	if (applyBackground(doc, doc->LineFromPosition((int)startPos), end)) return;
+
+	//The line a slice yielded on has the lexers full state, so needs no lines before it
+	int startLine = _sliceVersion == _version && _sliceResumable && startPos == _slicePos ?
+		doc->LineFromPosition((int)startPos) : restartLine(doc, doc->LineFromPosition((int)startPos));
+	unsigned actualStartPos = (unsigned)doc->LineStart(startLine);
+	assert(actualStartPos <= startPos);
+
+	unsigned syncEnd = end;
+	bool slice = false;
+	unsigned yieldAfter = 0;
+	if (end - actualStartPos > BACKGROUND_SYNC_LIMIT)
+	{
+		int syncEndLine = doc->LineFromPosition((int)(actualStartPos + BACKGROUND_SYNC_LIMIT));
+		//Only the visible lines are needed straight away
+		if (_viewport.endLine > doc->LineFromPosition((int)startPos))
+			syncEndLine = std::min(syncEndLine, _viewport.endLine - 1);
+		syncEnd = std::min(end, (unsigned)doc->LineStart(syncEndLine + 1));
+		if (_background && _factory)
+		{
+			if (syncEnd <= startPos)
+			{
+				//Too far back to the restart line to reach the requested lines, so leave all
+				//of it to the background thread
+				startBackground(doc, startLine);
+				return;
+			}
+		}
+		else
+		{
+			//Carry on past syncEnd to a line the next slice can resume from, with some more
+			//text for the lexer to look ahead into
+			slice = true;
+			yieldAfter = std::max(syncEnd, startPos) - actualStartPos;
+			syncEnd = std::min(end, (unsigned)doc->LineStart(
+				doc->LineFromPosition((int)(actualStartPos + yieldAfter + BACKGROUND_SYNC_LIMIT)) + 1));
+		}
+	}
+
+	bool converged, yielded = false;
+	{
+		DocumentStyleStream stream(doc, (unsigned)startLine, syncEnd - actualStartPos, nullptr, &_buffers);
+		stream.extendedLineStates(&_extendedStates);
+		if (!_fold && !readsFoldLevels()) stream.noFoldLevels();
+		//Without a recorded change, such as an edit the plugin did not see, the text after the
+		//lines may have changed too, so style the whole range
+		if (_changedFrom < _changedTo && _changedTo != INT_MAX)
+			stream.convergeFrom((unsigned)std::max(_changedTo, startLine + 1));
+		if (slice) stream.yieldAfter(yieldAfter);
+		style(stream);
+		converged = stream.converged();
+		if (stream.yielded())
+		{
+			yielded = true;
+			syncEnd = stream.yieldedPos();
+		}
+	}
+	styled(doc, startLine, syncEnd, converged);
+	if (converged || syncEnd >= end) return;
+
+	if (slice)
+	{
+		//Left for the plugin to continue with PRIVATE_BACKGROUND_PENDING when idle. If no line
+		//to yield on was found, the next slice restarts like any other Lex.
+		_sliceVersion = _version;
+		_slicePos = syncEnd;
+		_sliceResumable = yielded;
+	}
+	//The background thread restarts like the next Lex would, as the lines before syncEnd were
+	//styled without the text after them
+	else startBackground(doc, restartLine(doc, doc->LineFromPosition((int)syncEnd)));
+}
+
+void * SCI_METHOD BaseLexer::PrivateCall(int operation, void *pointer)
+{
+	switch (operation)
+	{
+	case PRIVATE_TEXT_CHANGED:
+		textChanged(*static_cast<const TextChange*>(pointer));
+		break;
+	case PRIVATE_BACKGROUND_PENDING:
+		if (_sliceVersion == _version && *static_cast<const int*>(pointer) == (int)_slicePos) return this;
+		takeFinishedJob();
+		//Lines may have been styled on this thread since the job started
+		if (_job && *static_cast<const int*>(pointer) >= _job->doc.LineStart(_job->endLine)) _job.reset();
+		return _job.get();
+	case PRIVATE_VIEWPORT:
+		_viewport = *static_cast<const Viewport*>(pointer);
+		break;
+	case PRIVATE_MEMORY_FOOTPRINT:
+		*static_cast<size_t*>(pointer) = _buffers.footprint() + (_thread ? _thread->footprint() : 0);
+		break;
+	}
+	return nullptr;
+}
+
+const char * SCI_METHOD BaseLexer::PropertyNames()
+{
+	return "lexer.background\nfold";
+}
+int SCI_METHOD BaseLexer::PropertyType(const char *name)
+{
+	return SC_TYPE_BOOLEAN;
+}
+const char * SCI_METHOD BaseLexer::DescribeProperty(const char *name)
+{
+	if (strcmp(name, "lexer.background") == 0)
+		return "Set to 0 to style large documents on the UI thread, rather than in the background.";
+	if (strcmp(name, "fold") == 0)
+		return "Set to 0 to not set fold levels and headers, when folding is not used.";
+	return "";
+}
+int SCI_METHOD BaseLexer::PropertySet(const char *key, const char *val)
+{
+	if (strcmp(key, "lexer.background") == 0) _background = strcmp(val, "0") != 0;
+	if (strcmp(key, "fold") == 0)
+	{
+		bool fold = strcmp(val, "0") != 0;
+		if (fold == _fold) return -1;
+		_fold = fold;
+		//The levels were not kept up to date for lexers that do not read them, so restyle
+		//everything
+		if (_fold)
+		{
+			restyleAll();
+			return 0;
+		}
+	}
+	//Styles do not depend on where they were done
+	return -1;
+}
+
+void BaseLexer::setWordList(int n, const std::shared_ptr<const WordList> &list)
+{
+	if ((size_t)n >= _wordLists.size()) _wordLists.resize((size_t)n + 1);
+	_wordLists[(size_t)n] = list;
+}
+int SCI_METHOD BaseLexer::WordListSet(int n, const char *wl)
+{
+	if (n < 0) return -1;
+	std::shared_ptr<const WordList> list(new WordList(wl));
+	if (list->empty()) list.reset();
+	auto &old = wordList(n);
+	if (list ? *list == old : old.empty()) return -1;
+	setWordList(n, list);
+	restyleAll();
+	return 0;
+}
+const WordList &BaseLexer::wordList(int n)const
+{
+	static const WordList empty;
+	return (size_t)n < _wordLists.size() && _wordLists[(size_t)n] ? *_wordLists[(size_t)n] : empty;
+}
+
+int BaseLexer::restartLine(IDocument *doc, int line)
+{
+	//if the edited lines indent changed, then its meaning may depend on the previous item
+	if (line > 0) --line;
+	while (line > 0)
+	{
+		unsigned state = (unsigned)doc->GetLineState(line);
+		if ((state & SAFE_START) && (!(state & EXTENDED_STATE) || !_extendedStates.get(line).empty()))
+			break;
+		--line;
+	}
+	return line;
+}
+
+void BaseLexer::textChanged(const TextChange &change)
+{
+	int from = change.line;
+	int to = change.line + std::max(change.linesAdded, 0) + 1;
+	if (_changedFrom < _changedTo)
+	{
+		//Move the existing lines with the text
+		if (_changedFrom > change.line) _changedFrom = std::max(from, _changedFrom + change.linesAdded);
+		if (_changedTo > change.line && _changedTo != INT_MAX) _changedTo = std::max(to, _changedTo + change.linesAdded);
+		from = std::min(from, _changedFrom);
+		to = std::max(to, _changedTo);
+	}
+	_changedFrom = from;
+	_changedTo = to;
+	if (change.linesAdded > 0) _extendedStates.insertLines(change.line, change.linesAdded);
+	else if (change.linesAdded < 0) _extendedStates.removeLines(change.line, -change.linesAdded);
+	if (_knownLength >= 0) _knownLength = change.length;
+	++_version;
+	//Any running job is for the old text
+	if (_thread) _thread->cancel();
+}
+
+void BaseLexer::restyleAll()
+{
+	_changedFrom = 0;
+	_changedTo = INT_MAX;
+	++_version;
+	if (_thread) _thread->cancel();
+}
+
+void BaseLexer::styled(IDocument *doc, int startLine, unsigned end, bool converged)
+{
+	//Changed lines up to where styling stopped are now done
+	if (_changedFrom >= _changedTo || startLine <= _changedFrom)
+	{
+		if (converged || end == (unsigned)doc->Length()) _changedFrom = _changedTo = 0;
+		else
+		{
+			//Lines after the end are still styled for the old text, so can not be reused
+			//until the new states catch up to them. Without a recorded change, any of them
+			//may have changed.
+			int endLine = doc->LineFromPosition((int)end);
+			_changedTo = _changedFrom < _changedTo ? std::max(_changedTo, endLine + 1) : INT_MAX;
+			_changedFrom = endLine;
+		}
+	}
+}
+
+void BaseLexer::takeFinishedJob()
+{
+	if (_thread)
+	{
+		auto job = _thread->finished();
+		if (job) _job = std::move(job);
+	}
+	if (_job && _job->version != _version) _job.reset();
+}
+
+bool BaseLexer::applyBackground(IDocument *doc, int line, unsigned end)
+{
+	if (!_thread) return false;
+	takeFinishedJob();
+	if (_job && line >= _job->doc.firstLine() && line < _job->endLine)
+	{
+		//The lines from the start of the job have not been applied yet, and were styled on
+		//this thread without the text after them
+		int from = std::min(line, _job->appliedLine);
+		unsigned batchEnd = std::min(end, (unsigned)doc->LineStart(line) + BACKGROUND_BATCH);
+		//An empty last line has nothing to style, but still has a level and state to apply
+		int batchTo = batchEnd >= (unsigned)doc->Length() ? _job->doc.lineCount() :
+			std::max(doc->LineFromPosition((int)batchEnd - 1) + 1, line + 1);
+		int to = std::min(batchTo, _job->endLine);
+
+		//Scintilla only knows the lines are styled up to the end of the last styles set, so
+		//show the viewport first
+		int showFrom = std::max(_viewport.firstLine, to), showTo = std::min(_viewport.endLine, _job->endLine);
+		if (showFrom < showTo && (showFrom < _job->shownFrom || showTo > _job->shownTo))
+		{
+			applyJobLines(doc, showFrom, showTo);
+			_job->shownFrom = showFrom;
+			_job->shownTo = showTo;
+			//Until the batches reach them, their states do not follow on from the lines
+			//before them, so do not converge on them
+			_changedFrom = _changedFrom < _changedTo ? std::min(_changedFrom, showFrom) : showFrom;
+			_changedTo = std::max(_changedTo, showTo + 1);
+		}
+
+		applyJobLines(doc, from, to);
+		_job->appliedLine = std::max(_job->appliedLine, to);
+
+		bool done = to == _job->endLine;
+		if (done && _job->converged && to < batchTo)
+		{
+			//The lines after it keep their styles, as with DocumentStyleStream, but still need
+			//marking as styled so the next Lex carries on from the end of the batch
+			doc->StartStyling(doc->LineStart(batchTo), (char)0xFF);
+			to = batchTo;
+		}
+		styled(doc, from, (unsigned)doc->LineStart(to), done && _job->converged);
+		if (done) _job.reset();
+		return true;
+	}
+	//Lines the running job will style are left until it finishes
+	return _jobVersion == _version && line >= _jobLine && _thread->busy();
+}
+
+void BaseLexer::applyJobLines(IDocument *doc, int from, int to)
+{
+	_job->doc.apply(doc, from, to);
+	for (int i = from; i < to; ++i) _extendedStates.set((unsigned)i, _job->extendedStates.get((unsigned)i));
+}
+
+void BaseLexer::startBackground(IDocument *doc, int line)
+{
+	if (_thread && _jobVersion == _version && _jobLine == line && _thread->busy()) return;
+
+	int convergeLine = _changedFrom < _changedTo && _changedTo != INT_MAX ? std::max(_changedTo, line + 1) : INT_MAX;
+	std::unique_ptr<LexerThread::Job> job(new LexerThread::Job(doc, line, convergeLine));
+	job->version = _version;
+	job->lexer.reset(static_cast<BaseLexer*>(_factory()));
+	for (size_t i = 0; i < _wordLists.size(); ++i)
+		if (_wordLists[i]) job->lexer->setWordList((int)i, _wordLists[i]);
+	job->extendedStates = _extendedStates;
+	job->foldLevels = _fold || readsFoldLevels();
+
+	if (!_thread) _thread.reset(new LexerThread());
+	_thread->start(std::move(job));
+	_jobVersion = _version;
+	_jobLine = line;
+	_job.reset();
+}
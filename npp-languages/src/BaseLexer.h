@@ -17,17 +17,94 @@
 #pragma once
 #include <ILexer.h> //Scintilla
 #include <memory>
+#include <climits>
 #include "StyleStream.h"
+#include "LexerThread.h"
+#include "WordList.h"
 #include <iostream>
+#include <vector>
+
+/**Details of a text change, sent by the plugin to the documents lexer with
+ * SCI_PRIVATELEXERCALL and BaseLexer::PRIVATE_TEXT_CHANGED.
+ */
+struct TextChange
+{
+	/**First line containing changed text.*/
+	int line;
+	/**Number of lines added, or negative if lines were removed.*/
+	int linesAdded;
+	/**Document length after the change.*/
+	int length;
+};
+
+/**Lines shown in a view of the document, sent by the plugin to the documents lexer with
+ * SCI_PRIVATELEXERCALL and BaseLexer::PRIVATE_VIEWPORT.
+ */
+struct Viewport
+{
+	/**First visible line.*/
+	int firstLine;
+	/**Line after the last visible line.*/
+	int endLine;
+};
 
 class BaseLexer : public ILexer
 {
 public:
+	/**PrivateCall operations used by the plugin.*/
+	enum PrivateCallOperation
+	{
+		/**pointer is a TextChange.*/
+		PRIVATE_TEXT_CHANGED = 1,
+		/**pointer is an int with the SCI_GETENDSTYLED position. Returns non-null if styles
+		 * from the background thread are ready to be applied by SCI_COLOURISE from there, or
+		 * a Lex on the UI thread stopped there and should be continued.
+		 */
+		PRIVATE_BACKGROUND_PENDING = 2,
+		/**pointer is a Viewport, styled before the rest of the document.*/
+		PRIVATE_VIEWPORT = 3,
+		/**pointer is a size_t, set to the bytes held in the lexers reusable StreamBuffers.*/
+		PRIVATE_MEMORY_FOOTPRINT = 4
+	};
+
 	//BaseLexer API
-	BaseLexer() {}
+	BaseLexer()
+		: _changedFrom(0), _changedTo(INT_MAX), _knownLength(-1), _extendedStates(), _buffers()
+		, _wordLists(), _fold(true)
+		, _factory(nullptr), _background(true), _version(0), _jobVersion(0), _jobLine(0)
+		, _thread(), _job(), _viewport(), _sliceVersion(UINT_MAX), _slicePos(0), _sliceResumable(false)
+	{}
 	virtual ~BaseLexer() {}
 
+	/**Set the factory that created this lexer, used to create more instances of it to style
+	 * on the background thread. Lexers without one are always styled on the UI thread.
+	 */
+	void factory(ILexer *(*factory)()) { _factory = factory; }
+
+	/**Line state flag for a line that style() can be started on with no prior context, other
+	 * than the fold level and the rest of the state stored for the line.
+	 * Lexers set this with StyleStream::lineState at the start of each top level statement.
+	 *
+	 * Inside a multi-line construct, lexers may set it with their own packed state in the
+	 * other 31 bits using StyleStream::advanceEol, and restore that state at the start of
+	 * style() from StyleStream::lineState().
+	 */
+	static const int SAFE_START = 1;
+	/**Line state flag for a line with more state than fits in the rest of the 32 bits, stored
+	 * in a LineStateTable with StyleStream::lineState and restored with
+	 * StyleStream::extendedLineState. Lexers must not use this bit for anything else.
+	 */
+	static const unsigned EXTENDED_STATE = 0x80000000;
+
 	virtual void style(StyleStream &stream) = 0;
+	/**True if style reads the fold levels back, so they are still needed when the fold
+	 * property is 0. Lexers that only set them for folding leave this false.
+	 */
+	virtual bool readsFoldLevels()const { return false; }
+	/**Sets word list n, as from WordListSet. Lexers that embed others override this to pass
+	 * their lists on to them.
+	 */
+	virtual void setWordList(int n, const std::shared_ptr<const WordList> &list);
 
 	//Scintilla API
 	virtual int SCI_METHOD Version()const override
@@ -38,42 +115,100 @@ public:
 	{
 		delete this;
 	}
-	virtual const char * SCI_METHOD PropertyNames()override
-	{
-		return "";
-	}
-	virtual int SCI_METHOD PropertyType(const char *name)override
-	{
-		return 0;
-	}
-	virtual const char * SCI_METHOD DescribeProperty(const char *name)
-	{
-		return "";
-	}
-	virtual int SCI_METHOD PropertySet(const char *key, const char *val)override
-	{
-		return 0;
-	}
+	virtual const char * SCI_METHOD PropertyNames()override;
+	virtual int SCI_METHOD PropertyType(const char *name)override;
+	virtual const char * SCI_METHOD DescribeProperty(const char *name);
+	virtual int SCI_METHOD PropertySet(const char *key, const char *val)override;
 	virtual const char * SCI_METHOD DescribeWordListSets()override
 	{
-		return "HTML Tag Names";
-	}
-	virtual int SCI_METHOD WordListSet(int n, const char *wl)override
-	{
-		return 0;
-	}
-	virtual void SCI_METHOD Lex(unsigned int startPos, int lengthDoc, int initStyle, IDocument *pAccess)override
-	{
-		DocumentStyleStream stream(pAccess);
-		style(stream);
+		return "";
 	}
+	/**Builds the WordList for wl, and restyles the document if it changed.*/
+	virtual int SCI_METHOD WordListSet(int n, const char *wl)override;
+	/**Styles the lines containing the requested range, starting from the nearest SAFE_START
+	 * line before it. Stops early after the changed lines once a line starts with the same
+	 * state as it did before.
+	 *
+	 * Large ranges are styled on the UI thread up to the end of the viewport, or at most
+	 * BACKGROUND_SYNC_LIMIT, then the rest of the document is styled from a snapshot on a
+	 * LexerThread. Until it finishes, requests for those lines are left unstyled, then the
+	 * results are applied in batches, with the viewport first.
+	 *
+	 * Without the background thread, large ranges are split into slices instead. Each Lex
+	 * stops on the first line past the limit it can resume from, and the next carries on
+	 * from that line state without restyling any lines before it.
+	 */
+	virtual void SCI_METHOD Lex(unsigned int startPos, int lengthDoc, int initStyle, IDocument *pAccess)override;
+	/**Does nothing, Lex sets the fold levels while styling unless the fold property is 0.*/
 	virtual void SCI_METHOD Fold(unsigned int startPos, int lengthDoc, int initStyle, IDocument *pAccess)override
 	{
 	}
-	virtual void * SCI_METHOD PrivateCall(int operation, void *pointer)override
-	{
-		return 0;
-	}
+	virtual void * SCI_METHOD PrivateCall(int operation, void *pointer)override;
+protected:
+	/**Finds the line to start lexing from in order to restyle line.*/
+	virtual int restartLine(IDocument *doc, int line);
+	/**Word list n, or an empty list if it was not set.*/
+	const WordList &wordList(int n)const;
+private:
+	/**Lines with text that may have changed since they were last styled.
+	 * [_changedFrom, _changedTo), empty if equal.
+	 */
+	int _changedFrom, _changedTo;
+	/**Document length after the last change seen. If the document is a different length, then
+	 * some changes were missed.
+	 */
+	int _knownLength;
+	/**Line states with EXTENDED_STATE, kept in line with the document by textChanged.*/
+	LineStateTable _extendedStates;
+	/**Buffers for the DocumentStyleStream of each Lex.*/
+	StreamBuffers _buffers;
+	/**Lists set with WordListSet, null if not set. Shared with the background jobs lexers.*/
+	std::vector<std::shared_ptr<const WordList>> _wordLists;
+	/**fold property.*/
+	bool _fold;
+
+	/**Most bytes to style on the UI thread in one Lex, before using the background thread.*/
+	static const unsigned BACKGROUND_SYNC_LIMIT = 256 * 1024;
+	/**Most bytes of background styles to apply in one Lex.*/
+	static const unsigned BACKGROUND_BATCH = 256 * 1024;
+
+	/**Creates the lexers for background jobs, or null.*/
+	ILexer *(*_factory)();
+	/**lexer.background property.*/
+	bool _background;
+	/**Counts changes to the text, to tell if a background job is out of date.*/
+	unsigned _version;
+	/**Version and first line of the last background job started.*/
+	unsigned _jobVersion;
+	int _jobLine;
+	/**Background thread, created when first needed.*/
+	std::unique_ptr<LexerThread> _thread;
+	/**Finished background job being applied to the document.*/
+	std::unique_ptr<LexerThread::Job> _job;
+	/**Visible lines from PRIVATE_VIEWPORT, empty if not known.*/
+	Viewport _viewport;
+	/**Version and end position of the last Lex that stopped before the end of its range.*/
+	unsigned _sliceVersion;
+	unsigned _slicePos;
+	/**True if the slice yielded on a line state, so the next can start on that line.*/
+	bool _sliceResumable;
+
+	void textChanged(const TextChange &change);
+	/**Marks the whole document as changed, for a setting that changes the styles.*/
+	void restyleAll();
+	/**Updates the changed lines after styling the lines from startLine to end.*/
+	void styled(IDocument *doc, int startLine, unsigned end, bool converged);
+	/**Takes the finished background job, if it is for the current text.*/
+	void takeFinishedJob();
+	/**Applies background styles for line onwards, up to end, and the viewport if it is
+	 * after them.
+	 * @return False if the lines must be styled on this thread.
+	 */
+	bool applyBackground(IDocument *doc, int line, unsigned end);
+	/**Applies the lines [from, to) of the finished job.*/
+	void applyJobLines(IDocument *doc, int from, int to);
+	/**Starts styling from line to the end of the document on the background thread.*/
+	void startBackground(IDocument *doc, int line);
 };
 
 struct LexerInfo
@@ -85,5 +220,7 @@ struct LexerInfo
 template<typename T>
 ILexer *lexerFactory()
 {
-	return new T();
+	auto lexer = new T();
+	lexer->factory(lexerFactory<T>);
+	return lexer;
 }
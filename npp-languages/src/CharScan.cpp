@@ -0,0 +1,180 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "CharScan.h"
+#if defined(__AVX2__)
+#	define CHARSCAN_AVX2
+#	include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#	define CHARSCAN_SSE2
+#	include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif
+
+namespace
+{
+#if defined(CHARSCAN_AVX2) || defined(CHARSCAN_SSE2)
+	/**Index of the lowest set bit of a non-zero mask.*/
+	unsigned lowestBit(unsigned mask)
+	{
+		assert(mask != 0);
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanForward(&i, mask);
+		return (unsigned)i;
+#else
+		return (unsigned)__builtin_ctz(mask);
+#endif
+	}
+#endif
+
+	const char *findAnyScalar(const char *begin, const char *end, const ByteSet &set)
+	{
+		for (; begin < end; ++begin)
+		{
+			if (set.contains(*begin)) return begin;
+		}
+		return end;
+	}
+
+	constexpr unsigned char charClass(unsigned c)
+	{
+		return (unsigned char)(
+			(c >= '0' && c <= '9' ? CHAR_DIGIT : 0) |
+			(c >= 'a' && c <= 'z' ? CHAR_LOWER : 0) |
+			(c >= 'A' && c <= 'Z' ? CHAR_UPPER : 0) |
+			(c == '_' ? CHAR_UNDERSCORE : 0) |
+			(c == '-' ? CHAR_HYPHEN : 0) |
+			((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') ? CHAR_HEX_LETTER : 0) |
+			(c == ' ' || c == '\t' ? CHAR_SPACE : 0) |
+			(c >= 0x80 ? CHAR_HIGH : 0));
+	}
+
+	const char *skipClassScalar(const char *begin, const char *end, CharClass mask)
+	{
+		while (begin < end && (CHAR_CLASSES[(unsigned char)*begin] & mask)) ++begin;
+		return begin;
+	}
+
+#if defined(CHARSCAN_AVX2)
+	/**Bit hi of the result is set if the byte (hi << 4) | lo has the class bit, for the ASCII
+	 * rows hi 0 to 7.
+	 */
+	constexpr unsigned char classRow(unsigned bit, unsigned lo, unsigned hi)
+	{
+		return (unsigned char)(charClass(hi * 16 + lo) & bit ? 1u << hi : 0);
+	}
+	constexpr unsigned char classRows(unsigned bit, unsigned lo)
+	{
+		return (unsigned char)(
+			classRow(bit, lo, 0) | classRow(bit, lo, 1) | classRow(bit, lo, 2) | classRow(bit, lo, 3) |
+			classRow(bit, lo, 4) | classRow(bit, lo, 5) | classRow(bit, lo, 6) | classRow(bit, lo, 7));
+	}
+#	define CLASS_ROWS_16(bit) { \
+		classRows(bit, 0), classRows(bit, 1), classRows(bit, 2), classRows(bit, 3), \
+		classRows(bit, 4), classRows(bit, 5), classRows(bit, 6), classRows(bit, 7), \
+		classRows(bit, 8), classRows(bit, 9), classRows(bit, 10), classRows(bit, 11), \
+		classRows(bit, 12), classRows(bit, 13), classRows(bit, 14), classRows(bit, 15) }
+	/**classRows for each CharClass bit, indexed by the low nibble. A mask is the union of its
+	 * bits rows, so needs no table of its own.
+	 */
+	const unsigned char CLASS_ROWS[8][16] =
+	{
+		CLASS_ROWS_16(0x01), CLASS_ROWS_16(0x02), CLASS_ROWS_16(0x04), CLASS_ROWS_16(0x08),
+		CLASS_ROWS_16(0x10), CLASS_ROWS_16(0x20), CLASS_ROWS_16(0x40), CLASS_ROWS_16(0x80)
+	};
+#	undef CLASS_ROWS_16
+#endif
+}
+
+const unsigned char CHAR_CLASSES[256] = BYTE_TABLE(charClass);
+
+#if defined(CHARSCAN_AVX2)
+const char *findAny(const char *begin, const char *end, const ByteSet &set)
+{
+	__m256i needles[ByteSet::MAX_SIZE];
+	for (unsigned i = 0; i < set.size(); ++i) needles[i] = _mm256_set1_epi8(set[i]);
+	for (; end - begin >= 32; begin += 32)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+		__m256i eq = _mm256_setzero_si256();
+		for (unsigned i = 0; i < set.size(); ++i) eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(block, needles[i]));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(eq);
+		if (mask) return begin + lowestBit(mask);
+	}
+	return findAnyScalar(begin, end, set);
+}
+#elif defined(CHARSCAN_SSE2)
+const char *findAny(const char *begin, const char *end, const ByteSet &set)
+{
+	__m128i needles[ByteSet::MAX_SIZE];
+	for (unsigned i = 0; i < set.size(); ++i) needles[i] = _mm_set1_epi8(set[i]);
+	for (; end - begin >= 16; begin += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+		__m128i eq = _mm_setzero_si128();
+		for (unsigned i = 0; i < set.size(); ++i) eq = _mm_or_si128(eq, _mm_cmpeq_epi8(block, needles[i]));
+		unsigned mask = (unsigned)_mm_movemask_epi8(eq);
+		if (mask) return begin + lowestBit(mask);
+	}
+	return findAnyScalar(begin, end, set);
+}
+#else
+const char *findAny(const char *begin, const char *end, const ByteSet &set)
+{
+	return findAnyScalar(begin, end, set);
+}
+#endif
+
+#if defined(CHARSCAN_AVX2)
+const char *skipClass(const char *begin, const char *end, CharClass mask)
+{
+	__m128i rows = _mm_setzero_si128();
+	for (unsigned bit = 0; bit < 8; ++bit)
+	{
+		if (mask & (1u << bit))
+			rows = _mm_or_si128(rows, _mm_loadu_si128(reinterpret_cast<const __m128i*>(CLASS_ROWS[bit])));
+	}
+	//A byte is in the mask if its row from the low nibble has the bit for its high nibble.
+	//High nibbles 8 to 15 look up 0, so the non-ASCII bytes are added from their sign bits.
+	const __m256i rowTable = _mm256_broadcastsi128_si256(rows);
+	const __m256i bitTable = _mm256_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+		1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const __m256i zero = _mm256_setzero_si256();
+	bool high = (mask & CHAR_HIGH) != 0;
+	for (; end - begin >= 32; begin += 32)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+		__m256i lo = _mm256_and_si256(block, nibble);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+		__m256i in = _mm256_and_si256(_mm256_shuffle_epi8(rowTable, lo), _mm256_shuffle_epi8(bitTable, hi));
+		unsigned match = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, zero));
+		if (high) match |= (unsigned)_mm256_movemask_epi8(block);
+		if (~match) return begin + lowestBit(~match);
+	}
+	return skipClassScalar(begin, end, mask);
+}
+#else
+const char *skipClass(const char *begin, const char *end, CharClass mask)
+{
+	return skipClassScalar(begin, end, mask);
+}
+#endif
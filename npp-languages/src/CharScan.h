@@ -0,0 +1,105 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <cassert>
+
+/**A small set of bytes to search text for with findAny.*/
+class ByteSet
+{
+public:
+	/**Most bytes in a set.*/
+	static const unsigned MAX_SIZE = 16;
+
+	/**Set of the bytes in a null terminated string.*/
+	explicit ByteSet(const char *chars) : _chars(), _size(0)
+	{
+		for (; *chars; ++chars) add(*chars);
+	}
+
+	void add(char c)
+	{
+		if (contains(c)) return;
+		assert(_size < MAX_SIZE);
+		_chars[_size++] = c;
+	}
+	bool contains(char c)const
+	{
+		for (unsigned i = 0; i < _size; ++i)
+		{
+			if (_chars[i] == c) return true;
+		}
+		return false;
+	}
+	unsigned size()const { return _size; }
+	char operator[](unsigned i)const { return _chars[i]; }
+private:
+	char _chars[MAX_SIZE];
+	unsigned _size;
+};
+
+/**Finds the first byte in [begin, end) that is in set, or end.
+ * Scans 32 bytes at a time with AVX2 if the build targets it, else 16 at a time with SSE2,
+ * with a plain loop for the remainder and other targets.
+ */
+const char *findAny(const char *begin, const char *end, const ByteSet &set);
+
+/**Character classes for CHAR_CLASSES, as bits that can be combined into a mask.*/
+enum CharClass
+{
+	CHAR_DIGIT = 0x01,
+	CHAR_LOWER = 0x02,
+	CHAR_UPPER = 0x04,
+	CHAR_UNDERSCORE = 0x08,
+	CHAR_HYPHEN = 0x10,
+	/**'a' to 'f' and 'A' to 'F'.*/
+	CHAR_HEX_LETTER = 0x20,
+	/**' ' and '\t'.*/
+	CHAR_SPACE = 0x40,
+	/**Bytes 0x80 and above, parts of UTF-8 characters.*/
+	CHAR_HIGH = 0x80,
+
+	CHAR_ALPHA = CHAR_LOWER | CHAR_UPPER,
+	CHAR_ALNUM = CHAR_DIGIT | CHAR_ALPHA,
+	CHAR_HEX = CHAR_DIGIT | CHAR_HEX_LETTER,
+	/**Ruby names.*/
+	CHAR_WORD = CHAR_ALNUM | CHAR_UNDERSCORE,
+	/**CSS identifiers.*/
+	CHAR_CSS_NAME = CHAR_WORD | CHAR_HYPHEN,
+	/**XML and HTML names, which may contain non-ASCII letters.*/
+	CHAR_XML_NAME = CHAR_CSS_NAME | CHAR_HIGH
+};
+/**CharClass bits of each byte.*/
+extern const unsigned char CHAR_CLASSES[256];
+
+/**Initializer for a table of f(c) for each byte c from 0 to 255, where f is constexpr.*/
+#define BYTE_TABLE(f) { BYTE_TABLE_64(f, 0x00), BYTE_TABLE_64(f, 0x40), BYTE_TABLE_64(f, 0x80), BYTE_TABLE_64(f, 0xC0) }
+#define BYTE_TABLE_64(f, c) BYTE_TABLE_16(f, c), BYTE_TABLE_16(f, c + 0x10), BYTE_TABLE_16(f, c + 0x20), BYTE_TABLE_16(f, c + 0x30)
+#define BYTE_TABLE_16(f, c) BYTE_TABLE_4(f, c), BYTE_TABLE_4(f, c + 4), BYTE_TABLE_4(f, c + 8), BYTE_TABLE_4(f, c + 12)
+#define BYTE_TABLE_4(f, c) f(c), f(c + 1), f(c + 2), f(c + 3)
+
+/**True if c, an unsigned byte as from StyleStream::peek, is in one of the classes in mask.*/
+inline bool charIs(int c, CharClass mask)
+{
+	return c >= 0 && c < 256 && (CHAR_CLASSES[c] & mask) != 0;
+}
+
+/**Finds the first byte in [begin, end) that is not in one of the classes in mask, or end.
+ * Classifies 32 bytes at a time with AVX2 shuffle lookups if the build targets it, else uses
+ * CHAR_CLASSES a byte at a time.
+ */
+const char *skipClass(const char *begin, const char *end, CharClass mask);
@@ -0,0 +1,190 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "DocumentSnapshot.h"
+#include <Scintilla.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+DocumentSnapshot::DocumentSnapshot(IDocument *doc, int line, int convergeLine)
+	: _line(line), _startPos(doc->LineStart(line)), _codePage(doc->CodePage())
+	, _text((size_t)(doc->Length() - _startPos)), _styles(_text.size())
+	, _lineStarts(), _levels(), _states(), _stylingPos(_startPos)
+{
+	if (!_text.empty()) doc->GetCharRange(_text.data(), _startPos, (int)_text.size());
+
+	//The lexers only support CR, LF and CRLF line ends, so the lines can be found from the
+	//copy rather than asking the document for each one
+	_lineStarts.push_back(_startPos);
+	for (size_t i = 0; i < _text.size(); ++i)
+	{
+		if (_text[i] == '\n' || (_text[i] == '\r' && (i + 1 == _text.size() || _text[i + 1] != '\n')))
+			_lineStarts.push_back(_startPos + (int)i + 1);
+	}
+	_lineStarts.push_back(Length());
+	assert(lineCount() == doc->LineFromPosition(doc->Length()) + 1);
+
+	int infoLine = std::max(line - 1, 0);
+	_levels.assign((size_t)(lineCount() - infoLine), SC_FOLDLEVELBASE);
+	_states.assign(_levels.size(), 0);
+	int infoEnd = std::min(line + 1, lineCount());
+	if (convergeLine < lineCount())
+	{
+		int windowEnd = LineStart(convergeLine) + CONVERGE_WINDOW;
+		if (windowEnd > Length()) windowEnd = Length();
+		infoEnd = std::max(infoEnd, LineFromPosition(windowEnd) + 1);
+	}
+	for (int i = infoLine; i < infoEnd; ++i)
+	{
+		_levels[(size_t)(i - infoLine)] = doc->GetLevel(i);
+		_states[(size_t)(i - infoLine)] = doc->GetLineState(i);
+	}
+}
+
+void DocumentSnapshot::apply(IDocument *doc, int from, int to)const
+{
+	assert(from >= _line && from <= to && to <= lineCount());
+	int start = LineStart(from), end = LineStart(to);
+	if (end > start)
+	{
+		doc->StartStyling(start, (char)0xFF);
+		doc->SetStyles(end - start, _styles.data() + (start - _startPos));
+	}
+	//The level and state of line to are set by styling the line before it, and applied with
+	//the lines after it
+	for (int line = from; line < to; ++line)
+	{
+		if (infoIndex(line) < 0) continue;
+		int level = GetLevel(line);
+		if (level != doc->GetLevel(line)) doc->SetLevel(line, level);
+		doc->SetLineState(line, GetLineState(line));
+	}
+}
+
+int SCI_METHOD DocumentSnapshot::Version()const
+{
+	return dvOriginal;
+}
+void SCI_METHOD DocumentSnapshot::SetErrorStatus(int status)
+{
+}
+int SCI_METHOD DocumentSnapshot::Length()const
+{
+	return _startPos + (int)_text.size();
+}
+void SCI_METHOD DocumentSnapshot::GetCharRange(char *buffer, int position, int lengthRetrieve)const
+{
+	assert(position >= _startPos && position + lengthRetrieve <= Length());
+	memcpy(buffer, _text.data() + (position - _startPos), (size_t)lengthRetrieve);
+}
+char SCI_METHOD DocumentSnapshot::StyleAt(int position)const
+{
+	if (position < _startPos || position >= Length()) return 0;
+	return _styles[(size_t)(position - _startPos)];
+}
+int SCI_METHOD DocumentSnapshot::LineFromPosition(int position)const
+{
+	if (position < _startPos) return std::max(_line - 1, 0);
+	auto it = std::upper_bound(_lineStarts.begin(), _lineStarts.end() - 1, position);
+	return _line + (int)(it - _lineStarts.begin()) - 1;
+}
+int SCI_METHOD DocumentSnapshot::LineStart(int line)const
+{
+	assert(line >= _line);
+	if (line < _line) return _startPos;
+	if (line >= lineCount()) return Length();
+	return _lineStarts[(size_t)(line - _line)];
+}
+int SCI_METHOD DocumentSnapshot::GetLevel(int line)const
+{
+	int i = infoIndex(line);
+	return i >= 0 ? _levels[(size_t)i] : SC_FOLDLEVELBASE;
+}
+int SCI_METHOD DocumentSnapshot::SetLevel(int line, int level)
+{
+	int i = infoIndex(line);
+	if (i < 0) return SC_FOLDLEVELBASE;
+	int prev = _levels[(size_t)i];
+	_levels[(size_t)i] = level;
+	return prev;
+}
+int SCI_METHOD DocumentSnapshot::GetLineState(int line)const
+{
+	int i = infoIndex(line);
+	return i >= 0 ? _states[(size_t)i] : 0;
+}
+int SCI_METHOD DocumentSnapshot::SetLineState(int line, int state)
+{
+	int i = infoIndex(line);
+	if (i < 0) return 0;
+	int prev = _states[(size_t)i];
+	_states[(size_t)i] = state;
+	return prev;
+}
+void SCI_METHOD DocumentSnapshot::StartStyling(int position, char mask)
+{
+	assert(position >= _startPos);
+	_stylingPos = position;
+}
+bool SCI_METHOD DocumentSnapshot::SetStyleFor(int length, char style)
+{
+	assert(_stylingPos + length <= Length());
+	memset(_styles.data() + (_stylingPos - _startPos), style, (size_t)length);
+	_stylingPos += length;
+	return true;
+}
+bool SCI_METHOD DocumentSnapshot::SetStyles(int length, const char *styles)
+{
+	assert(_stylingPos + length <= Length());
+	memcpy(_styles.data() + (_stylingPos - _startPos), styles, (size_t)length);
+	_stylingPos += length;
+	return true;
+}
+void SCI_METHOD DocumentSnapshot::DecorationSetCurrentIndicator(int indicator)
+{
+}
+void SCI_METHOD DocumentSnapshot::DecorationFillRange(int position, int value, int fillLength)
+{
+}
+void SCI_METHOD DocumentSnapshot::ChangeLexerState(int start, int end)
+{
+}
+int SCI_METHOD DocumentSnapshot::CodePage()const
+{
+	return _codePage;
+}
+bool SCI_METHOD DocumentSnapshot::IsDBCSLeadByte(char ch)const
+{
+	//The lexers only look at ASCII, so do not need this
+	return false;
+}
+const char * SCI_METHOD DocumentSnapshot::BufferPointer()
+{
+	//Indexed by document position like Scintillas, only valid from _startPos
+	return _text.data() - _startPos;
+}
+int SCI_METHOD DocumentSnapshot::GetLineIndentation(int line)
+{
+	//Not used by the lexers, they count their own indentation from the text
+	return 0;
+}
+
+int DocumentSnapshot::infoIndex(int line)const
+{
+	int i = line - std::max(_line - 1, 0);
+	return i >= 0 && i < (int)_levels.size() ? i : -1;
+}
@@ -0,0 +1,89 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <ILexer.h> //Scintilla
+#include <vector>
+
+/**A copy of a document that can be styled away from the UI thread.
+ * Holds the text from the first line to be styled to the end of the document, with the fold
+ * levels and line states of those lines and the line before. Only positions from the first
+ * line can be read. Styles, levels and states set by a lexer are kept so they can be applied
+ * to the real document later.
+ *
+ * The old levels and states are only read from the document for the lines styling may stop
+ * on, the others start as SC_FOLDLEVELBASE and 0 and so never match a state to converge on.
+ */
+class DocumentSnapshot : public IDocument
+{
+public:
+	/**Bytes after the start of the converge line to read the old levels and states for.*/
+	static const int CONVERGE_WINDOW = 256 * 1024;
+
+	/**Copies doc, to be styled from line to the end, stopping at or after convergeLine if the
+	 * states converge, or never if it is INT_MAX.
+	 */
+	DocumentSnapshot(IDocument *doc, int line, int convergeLine);
+	virtual ~DocumentSnapshot() {}
+
+	/**First line to be styled.*/
+	int firstLine()const { return _line; }
+	/**Number of lines in the document.*/
+	int lineCount()const { return _line + (int)_lineStarts.size() - 1; }
+	/**Copies the styles, fold levels and states of lines [from, to) to doc.*/
+	void apply(IDocument *doc, int from, int to)const;
+
+	//IDocument
+	virtual int SCI_METHOD Version()const override;
+	virtual void SCI_METHOD SetErrorStatus(int status)override;
+	virtual int SCI_METHOD Length()const override;
+	virtual void SCI_METHOD GetCharRange(char *buffer, int position, int lengthRetrieve)const override;
+	virtual char SCI_METHOD StyleAt(int position)const override;
+	virtual int SCI_METHOD LineFromPosition(int position)const override;
+	virtual int SCI_METHOD LineStart(int line)const override;
+	virtual int SCI_METHOD GetLevel(int line)const override;
+	virtual int SCI_METHOD SetLevel(int line, int level)override;
+	virtual int SCI_METHOD GetLineState(int line)const override;
+	virtual int SCI_METHOD SetLineState(int line, int state)override;
+	virtual void SCI_METHOD StartStyling(int position, char mask)override;
+	virtual bool SCI_METHOD SetStyleFor(int length, char style)override;
+	virtual bool SCI_METHOD SetStyles(int length, const char *styles)override;
+	virtual void SCI_METHOD DecorationSetCurrentIndicator(int indicator)override;
+	virtual void SCI_METHOD DecorationFillRange(int position, int value, int fillLength)override;
+	virtual void SCI_METHOD ChangeLexerState(int start, int end)override;
+	virtual int SCI_METHOD CodePage()const override;
+	virtual bool SCI_METHOD IsDBCSLeadByte(char ch)const override;
+	virtual const char * SCI_METHOD BufferPointer()override;
+	virtual int SCI_METHOD GetLineIndentation(int line)override;
+private:
+	/**First line to be styled.*/
+	int _line;
+	/**Start of _line, the first position in _styles.*/
+	int _startPos;
+	int _codePage;
+	/**Text from _startPos.*/
+	std::vector<char> _text;
+	std::vector<char> _styles;
+	/**Start of each line from _line, and the document length.*/
+	std::vector<int> _lineStarts;
+	/**Fold level and line state of each line from the line before _line.*/
+	std::vector<int> _levels, _states;
+	/**Position set by StartStyling.*/
+	int _stylingPos;
+
+	/**Index in _levels and _states, or -1 if the line is not in the snapshot.*/
+	int infoIndex(int line)const;
+};
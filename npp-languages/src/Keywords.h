@@ -0,0 +1,54 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include "StyleStream.h"
+#include <cstddef>
+
+/**An entry in a keyword table for findKeyword.
+ * Tables are arrays of these built from string literals with KEYWORD, so they are constant
+ * data that needs no initialisation when the DLL is loaded.
+ */
+struct Keyword
+{
+	const char *word;
+	unsigned len;
+};
+/**Keyword table entry for a string literal.*/
+#define KEYWORD(word) { word, sizeof(word) - 1 }
+
+/**Finds the keyword that is the len elements of stream from start.
+ * @param table Keywords ordered by length, so only those of length len are compared.
+ * @return Index of the keyword in table, or -1.
+ */
+template<size_t N>
+int findKeyword(const Keyword (&table)[N], const StyleStream &stream, unsigned len, unsigned start = 0)
+{
+	size_t first = 0, last = N;
+	while (first < last)
+	{
+		size_t mid = (first + last) / 2;
+		if (table[mid].len < len) first = mid + 1;
+		else last = mid;
+	}
+	int c = stream.peek(start);
+	for (size_t i = first; i < N && table[i].len == len; ++i)
+	{
+		assert(i == 0 || table[i - 1].len <= table[i].len);
+		if (table[i].word[0] == c && stream.matches(table[i].word, start)) return (int)i;
+	}
+	return -1;
+}
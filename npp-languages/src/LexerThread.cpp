@@ -0,0 +1,110 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "LexerThread.h"
+#include "BaseLexer.h"
+#include <climits>
+
+LexerThread::Job::Job(IDocument *doc, int line, int convergeLine)
+	: version(0), lexer(), doc(doc, line, convergeLine), extendedStates(), foldLevels(true)
+	, convergeLine(convergeLine), endLine(line), converged(false), appliedLine(line)
+	, shownFrom(0), shownTo(0)
+{
+}
+LexerThread::Job::~Job()
+{
+}
+
+LexerThread::LexerThread()
+	: _mutex(), _wake(), _queued(), _finished(), _running(false), _quit(false), _cancelled(false)
+	, _buffers()
+	, _thread(&LexerThread::run, this)
+{
+}
+LexerThread::~LexerThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+		_queued.reset();
+		_cancelled = true;
+	}
+	_wake.notify_one();
+	_thread.join();
+}
+
+void LexerThread::start(std::unique_ptr<Job> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queued = std::move(job);
+	}
+	_wake.notify_one();
+}
+void LexerThread::cancel()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_queued.reset();
+	if (_running) _cancelled = true;
+}
+bool LexerThread::busy()const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _running || _queued;
+}
+std::unique_ptr<LexerThread::Job> LexerThread::finished()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return std::move(_finished);
+}
+
+void LexerThread::run()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		_wake.wait(lock, [this]{ return _quit || _queued; });
+		if (_quit) break;
+
+		auto job = std::move(_queued);
+		_running = true;
+		_cancelled = false;
+		lock.unlock();
+		bool done = style(*job, _cancelled, _buffers);
+		lock.lock();
+		_running = false;
+		//Partial results are never published
+		if (done) _finished = std::move(job);
+	}
+}
+
+bool LexerThread::style(Job &job, const std::atomic<bool> &cancel, StreamBuffers &buffers)
+{
+	int line = job.doc.firstLine();
+	//The snapshot is never modified while it is styled, so is read in place
+	int start = job.doc.LineStart(line);
+	DocumentStyleStream stream(&job.doc, (unsigned)line, (unsigned)(job.doc.Length() - start),
+		job.doc.BufferPointer() + start, &buffers);
+	stream.extendedLineStates(&job.extendedStates);
+	if (!job.foldLevels) stream.noFoldLevels();
+	if (job.convergeLine != INT_MAX) stream.convergeFrom((unsigned)job.convergeLine);
+	stream.cancelOn(&cancel);
+	job.lexer->style(stream);
+	if (stream.cancelled()) return false;
+	job.converged = stream.converged();
+	job.endLine = job.converged ? job.doc.LineFromPosition((int)stream.convergedPos()) : job.doc.lineCount();
+	return true;
+}
@@ -0,0 +1,94 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include "DocumentSnapshot.h"
+#include "LineStateTable.h"
+#include "StreamBuffers.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class BaseLexer;
+
+/**Worker thread that styles document snapshots for a BaseLexer.
+ * Each job has its own lexer instance, so the lexers per-instance state is never shared
+ * between threads. The results are applied to the document by the BaseLexer on the UI thread.
+ */
+class LexerThread
+{
+public:
+	/**A snapshot to style from its first line to the end, or until the states converge.*/
+	struct Job
+	{
+		Job(IDocument *doc, int line, int convergeLine);
+		~Job();
+
+		/**BaseLexer text change count when the snapshot was taken.*/
+		unsigned version;
+		/**Lexer to style with, only used by the worker thread.*/
+		std::unique_ptr<BaseLexer> lexer;
+		DocumentSnapshot doc;
+		LineStateTable extendedStates;
+		/**False if the lexer does not need fold levels, see DocumentStyleStream::noFoldLevels.*/
+		bool foldLevels;
+		/**Line to stop at if the state matches the old state, or INT_MAX.*/
+		int convergeLine;
+		/**Set by the worker. Lines [doc.firstLine(), endLine) were styled.*/
+		int endLine;
+		/**Set by the worker. True if styling stopped early at endLine.*/
+		bool converged;
+		/**Set on the UI thread. Lines before this have been applied to the document.*/
+		int appliedLine;
+		/**Set on the UI thread. Visible lines applied ahead of appliedLine.*/
+		int shownFrom, shownTo;
+	};
+
+	LexerThread();
+	/**Waits for the current job to finish.*/
+	~LexerThread();
+
+	/**Queues a job to style, replacing any job not yet started.*/
+	void start(std::unique_ptr<Job> job);
+	/**Drops the queued job, and stops the running job at its next line end without
+	 * finishing it. Used when the text changes, as the results would be discarded anyway.
+	 */
+	void cancel();
+	/**True if a job is queued or running.*/
+	bool busy()const;
+	/**Bytes held by the worker threads StreamBuffers.*/
+	size_t footprint()const { return _buffers.footprint(); }
+	/**Takes the most recently finished job, or null if there is none.*/
+	std::unique_ptr<Job> finished();
+private:
+	mutable std::mutex _mutex;
+	std::condition_variable _wake;
+	std::unique_ptr<Job> _queued, _finished;
+	bool _running, _quit;
+	/**Set to stop the running job, see DocumentStyleStream::cancelOn.*/
+	std::atomic<bool> _cancelled;
+	/**Only used by the worker thread, as each job has a new lexer.*/
+	StreamBuffers _buffers;
+	std::thread _thread;
+
+	void run();
+	/**Styles the job, unless cancel is set first.
+	 * @return False if cancelled.
+	 */
+	static bool style(Job &job, const std::atomic<bool> &cancel, StreamBuffers &buffers);
+};
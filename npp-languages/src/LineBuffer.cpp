@@ -0,0 +1,58 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "LineBuffer.h"
+#include <ILexer.h>
+
+LineBuffer::LineBuffer(IDocument *doc, int firstLine)
+	: _doc(doc), _firstLine(firstLine), _lines()
+{
+}
+
+void LineBuffer::flush()
+{
+	for (size_t i = 0; i < _lines.size(); ++i)
+	{
+		const Line &line = _lines[i];
+		if (line.level != line.oldLevel) _doc->SetLevel(_firstLine + (int)i, line.level);
+		if (line.state != line.oldState) _doc->SetLineState(_firstLine + (int)i, line.state);
+	}
+}
+
+LineBuffer::Line &LineBuffer::load(int line)
+{
+	if (line < _firstLine)
+	{
+		//Lexers may set the header flag of the line before they started on
+		_lines.insert(_lines.begin(), (size_t)(_firstLine - line), Line());
+		for (int i = line; i < _firstLine; ++i)
+		{
+			Line &entry = _lines[(size_t)(i - line)];
+			entry.oldLevel = entry.level = _doc->GetLevel(i);
+			entry.oldState = entry.state = _doc->GetLineState(i);
+		}
+		_firstLine = line;
+	}
+	while (_firstLine + (int)_lines.size() <= line)
+	{
+		int i = _firstLine + (int)_lines.size();
+		int level = _doc->GetLevel(i), state = _doc->GetLineState(i);
+		Line entry = {level, level, state, state};
+		_lines.push_back(entry);
+	}
+	return _lines[(size_t)(line - _firstLine)];
+}
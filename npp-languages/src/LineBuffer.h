@@ -0,0 +1,58 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class IDocument;
+
+/**Fold levels and line states set while styling, kept locally and written to the document
+ * by flush, skipping lines that did not change. Each line is read from the document once,
+ * when it is first used.
+ */
+class LineBuffer
+{
+public:
+	LineBuffer(IDocument *doc, int firstLine);
+
+	int level(int line) { return get(line).level; }
+	void level(int line, int level) { get(line).level = level; }
+	int state(int line) { return get(line).state; }
+	void state(int line, int state) { get(line).state = state; }
+	/**Writes the levels and states that changed to the document.*/
+	void flush();
+private:
+	struct Line
+	{
+		int oldLevel, level;
+		int oldState, state;
+	};
+	IDocument *_doc;
+	/**Line of _lines[0].*/
+	int _firstLine;
+	std::vector<Line> _lines;
+
+	Line &get(int line)
+	{
+		if (line >= _firstLine && line < _firstLine + (int)_lines.size())
+			return _lines[(size_t)(line - _firstLine)];
+		return load(line);
+	}
+	/**Reads lines up to line from the document.*/
+	Line &load(int line);
+};
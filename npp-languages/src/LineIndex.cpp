@@ -0,0 +1,71 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "LineIndex.h"
+#include "CharScan.h"
+#include <algorithm>
+#include <cassert>
+
+LineIndex::LineIndex()
+	: _lines(), _src(nullptr), _len(0), _next(0), _last(0)
+{
+}
+
+void LineIndex::reset(const char *src, unsigned len)
+{
+	_lines.clear();
+	_src = src;
+	_len = len;
+	_next = 0;
+	_last = 0;
+}
+void LineIndex::shrink()
+{
+	if (_lines.size() < _lines.capacity() / 2)
+	{
+		_lines.shrink_to_fit();
+	}
+}
+
+unsigned LineIndex::lineAt(unsigned pos)
+{
+	assert(pos < _len);
+	while (_next <= pos) indexLine();
+	//Lookups mostly stay on one line or move to the next
+	if (_last < _lines.size() && _lines[_last].start <= pos)
+	{
+		if (_last + 1 == _lines.size() || pos < _lines[_last + 1].start) return _last;
+		if (_last + 2 == _lines.size() || pos < _lines[_last + 2].start) return ++_last;
+	}
+	auto it = std::upper_bound(_lines.begin(), _lines.end(), pos,
+		[](unsigned pos, const Line &line) { return pos < line.start; });
+	_last = (unsigned)(it - _lines.begin()) - 1;
+	return _last;
+}
+
+void LineIndex::indexLine()
+{
+	static const ByteSet EOL("\r\n");
+	assert(_next <= _len);
+	const char *end = findAny(_src + _next, _src + _len, EOL);
+	Line line = {_next, (unsigned)(end - _src), 0};
+	line.indent = (unsigned)(skipClass(_src + line.start, end, CHAR_SPACE) - (_src + line.start));
+	_lines.push_back(line);
+
+	if (line.end == _len) _next = _len + 1;
+	else if (_src[line.end] == '\r' && line.end + 1 < _len && _src[line.end + 1] == '\n') _next = line.end + 2;
+	else _next = line.end + 1;
+}
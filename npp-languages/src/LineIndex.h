@@ -0,0 +1,71 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**Start, end and indent of each line of a block of text, so lexers can find line boundaries
+ * without scanning the same text again while trying different constructs.
+ *
+ * Lines are indexed as they are needed, so a stream that stops early only scans as far as it
+ * got.
+ */
+class LineIndex
+{
+public:
+	LineIndex();
+
+	/**Index len chars of src, discarding the previous index but keeping its memory.*/
+	void reset(const char *src, unsigned len);
+	/**Frees the memory if the last index used less than half of it.*/
+	void shrink();
+	/**Bytes allocated.*/
+	size_t capacity()const { return _lines.capacity() * sizeof(Line); }
+
+	const char *src()const { return _src; }
+	unsigned length()const { return _len; }
+	/**True if the text from p to p + len is part of the indexed text.*/
+	bool contains(const char *p, unsigned len)const
+	{
+		return _src && p >= _src && p + len <= _src + _len;
+	}
+	/**Line containing pos, which must be before the end of the text. Line end characters are
+	 * part of the line they end.
+	 */
+	unsigned lineAt(unsigned pos);
+	/**Position of the first character of line.*/
+	unsigned lineStart(unsigned line)const { return _lines[line].start; }
+	/**Position of the line end of line, or of the end of the text for the last line.*/
+	unsigned lineEnd(unsigned line)const { return _lines[line].end; }
+	/**Number of spaces and tabs at the start of line.*/
+	unsigned indent(unsigned line)const { return _lines[line].indent; }
+private:
+	struct Line
+	{
+		unsigned start, end, indent;
+	};
+	std::vector<Line> _lines;
+	const char *_src;
+	unsigned _len;
+	/**Start of the first line not yet indexed, or past _len once the last line is.*/
+	unsigned _next;
+	/**Line found by the last lineAt, tried first by the next.*/
+	unsigned _last;
+
+	/**Adds the line starting at _next.*/
+	void indexLine();
+};
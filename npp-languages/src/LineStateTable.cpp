@@ -0,0 +1,69 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "LineStateTable.h"
+#include <algorithm>
+#include <cassert>
+
+void LineStateTable::set(unsigned line, const Entry &entry)
+{
+	if (line >= size())
+	{
+		if (entry.empty()) return;
+		insertAt(size(), line + 1 - size());
+	}
+	_entries[index(line)] = entry;
+}
+void LineStateTable::insertLines(unsigned line, unsigned count)
+{
+	//Scintilla inserts the new lines after line, lines past the end are already empty
+	if (line + 1 < size()) insertAt(line + 1, count);
+}
+void LineStateTable::removeLines(unsigned line, unsigned count)
+{
+	unsigned first = line + 1;
+	if (first >= size()) return;
+	count = std::min(count, size() - first);
+	moveGap(first);
+	for (unsigned i = 0; i < count; ++i) Entry().swap(_entries[_gapStart + _gapLen + i]);
+	_gapLen += count;
+}
+void LineStateTable::clear()
+{
+	_entries.clear();
+	_gapStart = _gapLen = 0;
+}
+void LineStateTable::insertAt(unsigned line, unsigned count)
+{
+	moveGap(line, count);
+	_gapStart += count;
+	_gapLen -= count;
+}
+void LineStateTable::moveGap(unsigned line, unsigned len)
+{
+	assert(line <= size());
+	//Swap so the gap stays filled with empty entries
+	for (unsigned i = _gapStart; i > line; --i) _entries[i - 1].swap(_entries[i - 1 + _gapLen]);
+	for (unsigned i = _gapStart; i < line; ++i) _entries[i].swap(_entries[i + _gapLen]);
+	_gapStart = line;
+
+	if (_gapLen < len)
+	{
+		unsigned grow = std::max(len - _gapLen, (unsigned)_entries.size() / 2 + 16);
+		_entries.insert(_entries.begin() + _gapStart + _gapLen, grow, Entry());
+		_gapLen += grow;
+	}
+}
@@ -0,0 +1,57 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <vector>
+
+/**Per-line lexer state that does not fit in the 32bit Scintilla line state.
+ * Stored as a gap buffer, so lookups are O(1), and lines inserted or removed near the last
+ * change only move the gap.
+ */
+class LineStateTable
+{
+public:
+	typedef std::vector<unsigned> Entry;
+
+	LineStateTable() : _entries(), _gapStart(0), _gapLen(0) {}
+
+	/**Number of lines with storage. Lines after this have an empty entry.*/
+	unsigned size()const { return (unsigned)_entries.size() - _gapLen; }
+	/**Get the entry for a line, empty if it has none.*/
+	const Entry &get(unsigned line)const
+	{
+		static const Entry EMPTY;
+		return line < size() ? _entries[index(line)] : EMPTY;
+	}
+	/**Set the entry for a line. An empty entry removes it.*/
+	void set(unsigned line, const Entry &entry);
+	/**count empty lines were inserted after line.*/
+	void insertLines(unsigned line, unsigned count);
+	/**count lines after line were removed.*/
+	void removeLines(unsigned line, unsigned count);
+	/**Removes all entries.*/
+	void clear();
+private:
+	std::vector<Entry> _entries;
+	/**Position and length of the unused entries in _entries.*/
+	unsigned _gapStart, _gapLen;
+
+	unsigned index(unsigned line)const { return line < _gapStart ? line : line + _gapLen; }
+	/**Insert count empty entries before line.*/
+	void insertAt(unsigned line, unsigned count);
+	/**Move the gap to start at line, and make it at least len long.*/
+	void moveGap(unsigned line, unsigned len = 0);
+};
@@ -20,6 +20,7 @@
 #include <LexerModule.h> //must include before ExternalLexer.h
 #include <Platform.h> //must include before ExternalLexer.h
 #include <ExternalLexer.h>
+#include <chrono>
 
 #include <MISC/PluginsManager/PluginInterface.h>
 //#include <MISC/PluginsManager/PluginsManager.h>
@@ -61,6 +62,82 @@ namespace
 		{"Slim", L"Slim", lexerFactory<Slim>}
 	};
 	static const auto LEXER_CNT = sizeof(LEXERS) / sizeof(LEXERS[0]);
+	NppData nppData;
+	/**Timer for applyBackgroundStyles.*/
+	UINT_PTR backgroundTimer = 0;
+	/**Interval of backgroundTimer in milliseconds.*/
+	const UINT BACKGROUND_INTERVAL = 50;
+	/**Most time to spend applying background styles each interval.*/
+	const std::chrono::milliseconds BACKGROUND_BUDGET(10);
+
+	/**True if the Scintilla view is using one of the plugins lexers.*/
+	bool isOwnLexer(HWND scintilla)
+	{
+		char name[64] = { 0 };
+		if (SendMessage(scintilla, SCI_GETLEXERLANGUAGE, 0, 0) >= (LRESULT)sizeof(name)) return false;
+		SendMessage(scintilla, SCI_GETLEXERLANGUAGE, 0, (LPARAM)name);
+		for (size_t i = 0; i < LEXER_CNT; ++i)
+		{
+			if (strcmp(name, LEXERS[i].name) == 0) return true;
+		}
+		return false;
+	}
+	/**True if scintilla is the second view, showing the same document as the main view.*/
+	bool isDuplicateView(HWND scintilla)
+	{
+		return scintilla == nppData._scintillaSecondHandle &&
+			SendMessage(nppData._scintillaMainHandle, SCI_GETDOCPOINTER, 0, 0) ==
+			SendMessage(nppData._scintillaSecondHandle, SCI_GETDOCPOINTER, 0, 0);
+	}
+	/**Tells the lexer which lines changed, so it can stop relexing once the styles converge,
+	 * and move its extended line states with the inserted or removed lines.
+	 */
+	void textModified(SCNotification *msg)
+	{
+		auto scintilla = (HWND)msg->nmhdr.hwndFrom;
+		if (scintilla != nppData._scintillaMainHandle && scintilla != nppData._scintillaSecondHandle) return;
+		//Both views get the notification if they are showing the same document
+		if (isDuplicateView(scintilla)) return;
+		if (!isOwnLexer(scintilla)) return;
+
+		TextChange change;
+		change.line = (int)SendMessage(scintilla, SCI_LINEFROMPOSITION, (WPARAM)msg->position, 0);
+		change.linesAdded = msg->linesAdded;
+		change.length = (int)SendMessage(scintilla, SCI_GETLENGTH, 0, 0);
+		SendMessage(scintilla, SCI_PRIVATELEXERCALL, BaseLexer::PRIVATE_TEXT_CHANGED, (LPARAM)&change);
+	}
+	/**Tells the lexer which lines are visible, so it can style them before the rest.*/
+	void updateViewport(HWND scintilla)
+	{
+		auto firstVisible = SendMessage(scintilla, SCI_GETFIRSTVISIBLELINE, 0, 0);
+		auto linesOnScreen = SendMessage(scintilla, SCI_LINESONSCREEN, 0, 0);
+		Viewport viewport;
+		viewport.firstLine = (int)SendMessage(scintilla, SCI_DOCLINEFROMVISIBLE, (WPARAM)firstVisible, 0);
+		viewport.endLine = (int)SendMessage(scintilla, SCI_DOCLINEFROMVISIBLE, (WPARAM)(firstVisible + linesOnScreen), 0) + 1;
+		SendMessage(scintilla, SCI_PRIVATELEXERCALL, BaseLexer::PRIVATE_VIEWPORT, (LPARAM)&viewport);
+	}
+	/**Applies styles from the lexers background threads for the documents in each view, or
+	 * continues sliced styling on the UI thread, in batches until BACKGROUND_BUDGET runs out.
+	 * The lexers may only touch the document on the UI thread, and as a timer this only runs
+	 * once other messages are handled.
+	 */
+	VOID CALLBACK applyBackgroundStyles(HWND, UINT, UINT_PTR, DWORD)
+	{
+		auto deadline = std::chrono::steady_clock::now() + BACKGROUND_BUDGET;
+		HWND views[] = { nppData._scintillaMainHandle, nppData._scintillaSecondHandle };
+		for (auto scintilla : views)
+		{
+			if (!scintilla || isDuplicateView(scintilla) || !isOwnLexer(scintilla)) continue;
+			updateViewport(scintilla);
+			while (std::chrono::steady_clock::now() < deadline)
+			{
+				int endStyled = (int)SendMessage(scintilla, SCI_GETENDSTYLED, 0, 0);
+				if (!SendMessage(scintilla, SCI_PRIVATELEXERCALL, BaseLexer::PRIVATE_BACKGROUND_PENDING, (LPARAM)&endStyled))
+					break;
+				SendMessage(scintilla, SCI_COLOURISE, (WPARAM)endStyled, -1);
+			}
+		}
+	}
 
 	void init()
 	{
@@ -95,6 +172,8 @@ BOOL APIENTRY DllMain(HANDLE hinstDLL, DWORD fdwReason, LPVOID lpReserved)
 // Plugin API
 extern "C" __declspec(dllexport) void setInfo(NppData data)
 {
+	nppData = data;
+	backgroundTimer = SetTimer(NULL, 0, BACKGROUND_INTERVAL, applyBackgroundStyles);
 }
 extern "C" __declspec(dllexport) const TCHAR * getName()
 {
@@ -107,6 +186,16 @@ extern "C" __declspec(dllexport) FuncItem * getFuncsArray(int *outCount)
 }
 extern "C" __declspec(dllexport) void beNotified(SCNotification *msg)
 {
+	switch (msg->nmhdr.code)
+	{
+	case SCN_MODIFIED:
+		if (msg->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) textModified(msg);
+		break;
+	case NPPN_SHUTDOWN:
+		if (backgroundTimer) KillTimer(NULL, backgroundTimer);
+		backgroundTimer = 0;
+		break;
+	}
 }
 extern "C" __declspec(dllexport) LRESULT messageProc(UINT Message, WPARAM wParam, LPARAM lParam)
 {
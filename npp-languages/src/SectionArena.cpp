@@ -0,0 +1,77 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "SectionArena.h"
+
+namespace
+{
+	const size_t ALIGN = alignof(std::max_align_t);
+}
+
+SectionArena::SectionArena()
+	: _blocks(), _block(0), _used(0), _usedBefore(0), _capacity(0), _highWater(0)
+{
+}
+SectionArena::~SectionArena()
+{
+}
+
+void *SectionArena::allocate(size_t bytes)
+{
+	bytes = (bytes + ALIGN - 1) & ~(ALIGN - 1);
+	while (_block < _blocks.size() && _used + bytes > _blocks[_block].size)
+	{
+		_usedBefore += _used;
+		_used = 0;
+		++_block;
+	}
+	if (_block == _blocks.size()) addBlock(bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE);
+	void *p = _blocks[_block].data.get() + _used;
+	_used += bytes;
+	return p;
+}
+void SectionArena::reset()
+{
+	size_t used = _usedBefore + _used;
+	if (used > _highWater) _highWater = used;
+	if (_blocks.size() > 1)
+	{
+		_blocks.clear();
+		size_t capacity = _capacity;
+		_capacity = 0;
+		addBlock(capacity);
+	}
+	_block = 0;
+	_used = 0;
+	_usedBefore = 0;
+}
+void SectionArena::shrink()
+{
+	if (_highWater < _capacity / 2)
+	{
+		_blocks.clear();
+		_capacity = 0;
+	}
+	_highWater = 0;
+}
+
+void SectionArena::addBlock(size_t size)
+{
+	Block block = {std::unique_ptr<char[]>(new char[size]), size};
+	_blocks.push_back(std::move(block));
+	_capacity += size;
+}
@@ -0,0 +1,64 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**Memory for the section lists of sub streams that outgrow their inline storage. Everything
+ * is freed at once by reset when the DocumentStyleStream they are part of is done, so the
+ * blocks are reused by the next Lex rather than allocated again.
+ */
+class SectionArena
+{
+public:
+	/**Smallest block to allocate.*/
+	static const size_t BLOCK_SIZE = 4096;
+
+	SectionArena();
+	~SectionArena();
+
+	/**Get bytes of memory, aligned for any type. Valid until reset.*/
+	void *allocate(size_t bytes);
+	/**Free everything allocated. If more than one block was needed they are replaced by one
+	 * block large enough for all of them.
+	 */
+	void reset();
+	/**Free the blocks if the most used since the last shrink is less than half of them.*/
+	void shrink();
+	/**Bytes in the blocks.*/
+	size_t capacity()const { return _capacity; }
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+	std::vector<Block> _blocks;
+	/**Block being allocated from.*/
+	size_t _block;
+	/**Bytes used in _blocks[_block].*/
+	size_t _used;
+	/**Bytes used in the blocks before _block.*/
+	size_t _usedBefore;
+	size_t _capacity;
+	/**Most bytes used between resets since the last shrink.*/
+	size_t _highWater;
+
+	void addBlock(size_t size);
+};
@@ -0,0 +1,74 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <cassert>
+#include <cstring>
+#include <string>
+
+/**Text peeked from a StyleStream without allocating.
+ * Refers to the streams source text when the text is within one section, else holds a copy,
+ * which is stored inline unless it is longer than INLINE_SIZE.
+ */
+class StrView
+{
+public:
+	/**Longest copy stored without allocating.*/
+	static const unsigned INLINE_SIZE = 32;
+
+	StrView() : _src(nullptr), _size(0), _long() {}
+	/**View of size chars at src, which must outlive the view.*/
+	StrView(const char *src, unsigned size) : _src(src), _size(size), _long() {}
+
+	const char *data()const
+	{
+		if (_src) return _src;
+		return _size <= INLINE_SIZE ? _inline : _long.data();
+	}
+	unsigned size()const { return _size; }
+	bool empty()const { return _size == 0; }
+	char operator[](unsigned i)const
+	{
+		assert(i < _size);
+		return data()[i];
+	}
+	bool operator==(const char *str)const
+	{
+		return strncmp(data(), str, _size) == 0 && str[_size] == '\0';
+	}
+	bool operator!=(const char *str)const { return !(*this == str); }
+	std::string str()const { return std::string(data(), _size); }
+
+	/**Adds a char to the end of a copy.*/
+	void push_back(char c)
+	{
+		assert(!_src);
+		if (_size < INLINE_SIZE) _inline[_size] = c;
+		else
+		{
+			if (_size == INLINE_SIZE) _long.assign(_inline, INLINE_SIZE);
+			_long.push_back(c);
+		}
+		++_size;
+	}
+private:
+	/**Source text, or null for a copy.*/
+	const char *_src;
+	unsigned _size;
+	char _inline[INLINE_SIZE];
+	/**Copy of text longer than INLINE_SIZE.*/
+	std::string _long;
+};
@@ -0,0 +1,74 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "StreamBuffers.h"
+
+StreamBuffers::StreamBuffers()
+	: _src(), _arena(), _lineIndex(), _runs(), _extraFootprint(0), _uses(0), _footprint(0)
+{
+	_src.capacity = _src.highWater = 0;
+}
+StreamBuffers::~StreamBuffers()
+{
+}
+
+char *StreamBuffers::src(unsigned len)
+{
+	return get(_src, len);
+}
+void StreamBuffers::release()
+{
+	_arena.reset();
+	if (++_uses >= SHRINK_PERIOD)
+	{
+		_uses = 0;
+		shrink(_src);
+		_arena.shrink();
+		_lineIndex.shrink();
+		_runs.shrink();
+	}
+	updateExtraFootprint();
+}
+
+char *StreamBuffers::get(Buffer &buffer, unsigned len)
+{
+	if (len > buffer.capacity) resize(buffer, len);
+	if (len > buffer.highWater) buffer.highWater = len;
+	return buffer.data.get();
+}
+void StreamBuffers::shrink(Buffer &buffer)
+{
+	if (buffer.highWater < buffer.capacity / 2) resize(buffer, buffer.highWater);
+	buffer.highWater = 0;
+}
+void StreamBuffers::resize(Buffer &buffer, unsigned capacity)
+{
+	//The contents are not kept, so free the old buffer first to not need both at once
+	buffer.data.reset();
+	_footprint -= buffer.capacity;
+	buffer.capacity = 0;
+	if (capacity > 0) buffer.data.reset(new char[capacity]);
+	buffer.capacity = capacity;
+	_footprint += capacity;
+}
+void StreamBuffers::updateExtraFootprint()
+{
+	size_t capacity = _arena.capacity() + _lineIndex.capacity() + _runs.capacity();
+	_footprint += capacity;
+	_footprint -= _extraFootprint;
+	_extraFootprint = capacity;
+}
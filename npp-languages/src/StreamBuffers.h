@@ -0,0 +1,78 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "LineIndex.h"
+#include "SectionArena.h"
+#include "StyleRuns.h"
+
+/**Source buffer and style runs reused by each DocumentStyleStream of a lexer, so styling does
+ * not allocate and free document sized arrays every time.
+ *
+ * The buffers only grow while in use. Every SHRINK_PERIOD uses they are shrunk back to the
+ * largest size needed in that period, if that is less than half their size, so one large
+ * restyle does not hold on to the memory forever.
+ *
+ * Also holds the SectionArena for the sub streams made while styling, the LineIndex of the
+ * text being styled, and the StyleRuns the styles are kept in.
+ */
+class StreamBuffers
+{
+public:
+	/**Number of uses between checks to shrink the buffers.*/
+	static const unsigned SHRINK_PERIOD = 32;
+
+	StreamBuffers();
+	~StreamBuffers();
+
+	/**Get a source buffer of at least len chars.*/
+	char *src(unsigned len);
+	/**Arena for sub stream sections, reset by release.*/
+	SectionArena &arena() { return _arena; }
+	/**Line index for the source text, reset by the stream using it.*/
+	LineIndex &lineIndex() { return _lineIndex; }
+	/**Style runs for the top level stream, cleared by the stream using them.*/
+	StyleRuns &runs() { return _runs; }
+	/**Done with the buffers, arena and line index until the next use.*/
+	void release();
+	/**Bytes currently allocated. May be read from any thread.*/
+	size_t footprint()const { return _footprint; }
+private:
+	struct Buffer
+	{
+		std::unique_ptr<char[]> data;
+		unsigned capacity;
+		/**Largest size requested since the last shrink check.*/
+		unsigned highWater;
+	};
+	Buffer _src;
+	SectionArena _arena;
+	LineIndex _lineIndex;
+	StyleRuns _runs;
+	/**Bytes of _arena, _lineIndex and _runs included in _footprint.*/
+	size_t _extraFootprint;
+	unsigned _uses;
+	std::atomic<size_t> _footprint;
+
+	char *get(Buffer &buffer, unsigned len);
+	void shrink(Buffer &buffer);
+	void resize(Buffer &buffer, unsigned capacity);
+	void updateExtraFootprint();
+};
@@ -0,0 +1,119 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "StyleRuns.h"
+#include <ILexer.h>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	/**Shortest run to set with SetStyleFor, rather than with the runs around it.*/
+	const unsigned MIN_STYLE_FOR = 64;
+	/**Size of the buffer that short runs are collected in.*/
+	const unsigned STYLE_CHUNK = 4096;
+}
+
+StyleRuns::StyleRuns()
+	: _runs(), _gaps(), _end(0)
+{
+}
+
+void StyleRuns::clear()
+{
+	_runs.clear();
+	_gaps.clear();
+	_end = 0;
+}
+void StyleRuns::shrink()
+{
+	if (_runs.size() < _runs.capacity() / 2) _runs.shrink_to_fit();
+	if (_gaps.size() < _gaps.capacity() / 2) _gaps.shrink_to_fit();
+}
+
+void StyleRuns::addGap(char *styles, unsigned len)
+{
+	while (len > 0)
+	{
+		Run run;
+		run.len = len < MAX_LEN ? len : MAX_LEN;
+		run.gap = 1;
+		run.style = 0;
+		_runs.push_back(run);
+		_gaps.push_back(styles);
+		styles += run.len;
+		_end += run.len;
+		len -= run.len;
+	}
+}
+void StyleRuns::push(char style, unsigned len)
+{
+	while (len > 0)
+	{
+		Run run;
+		run.len = len < MAX_LEN ? len : MAX_LEN;
+		run.gap = 0;
+		run.style = (unsigned char)style;
+		_runs.push_back(run);
+		_end += run.len;
+		len -= run.len;
+	}
+}
+void StyleRuns::cut(unsigned pos)
+{
+	while (!_runs.empty() && _end - _runs.back().len >= pos)
+	{
+		_end -= _runs.back().len;
+		if (_runs.back().gap) _gaps.pop_back();
+		_runs.pop_back();
+	}
+	if (_end > pos)
+	{
+		_runs.back().len -= _end - pos;
+		_end = pos;
+	}
+}
+
+void StyleRuns::write(IDocument *doc, unsigned len)const
+{
+	assert(len <= _end);
+	char chunk[STYLE_CHUNK];
+	unsigned chunkLen = 0;
+	size_t gap = 0;
+	for (size_t i = 0; i < _runs.size() && len > 0; ++i)
+	{
+		const Run &run = _runs[i];
+		unsigned n = run.len < len ? run.len : len;
+		len -= n;
+		if (!run.gap && n < MIN_STYLE_FOR && chunkLen + n <= STYLE_CHUNK)
+		{
+			memset(chunk + chunkLen, (int)run.style, n);
+			chunkLen += n;
+			continue;
+		}
+		if (chunkLen > 0) doc->SetStyles((int)chunkLen, chunk);
+		chunkLen = 0;
+		if (run.gap) doc->SetStyles((int)n, _gaps[gap++]);
+		else if (n >= MIN_STYLE_FOR) doc->SetStyleFor((int)n, (char)run.style);
+		else
+		{
+			//A short run that did not fit in the chunk starts the next one
+			memset(chunk, (int)run.style, n);
+			chunkLen = n;
+		}
+	}
+	if (chunkLen > 0) doc->SetStyles((int)chunkLen, chunk);
+}
@@ -0,0 +1,85 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class IDocument; //Scintilla
+
+/**Styles set by the top level DocumentStyleStream, kept as runs of one style rather than a
+ * style for each position. The stream styles its text in order, so each run follows the last.
+ *
+ * Text given to sub streams is kept as a gap, with its own style array for the sub streams
+ * to write to, as they may style it in any order.
+ */
+class StyleRuns
+{
+public:
+	StyleRuns();
+
+	/**Remove all the runs, keeping their memory.*/
+	void clear();
+	/**Frees the memory if the last use needed less than half of it.*/
+	void shrink();
+	/**Bytes allocated.*/
+	size_t capacity()const { return _runs.capacity() * sizeof(Run) + _gaps.capacity() * sizeof(char*); }
+
+	/**Position after the last run.*/
+	unsigned end()const { return _end; }
+	/**Add len positions of style at end.*/
+	void add(char style, unsigned len)
+	{
+		if (!_runs.empty())
+		{
+			Run &last = _runs.back();
+			if (!last.gap && last.style == (unsigned char)style && len <= MAX_LEN - last.len)
+			{
+				last.len += len;
+				_end += len;
+				return;
+			}
+		}
+		push(style, len);
+	}
+	/**Add len positions at end whose styles are set in styles, which must stay valid until
+	 * the runs are written or cleared.
+	 */
+	void addGap(char *styles, unsigned len);
+	/**Remove the positions from pos onwards.*/
+	void cut(unsigned pos);
+	/**Set the styles of the first len positions from the documents styling position. Long
+	 * runs are set with SetStyleFor, the rest are collected into SetStyles calls.
+	 */
+	void write(IDocument *doc, unsigned len)const;
+private:
+	/**Longest run length, longer runs are split.*/
+	static const unsigned MAX_LEN = (1u << 23) - 1;
+	struct Run
+	{
+		unsigned len : 23;
+		/**Styles are in the next of _gaps rather than style.*/
+		unsigned gap : 1;
+		unsigned style : 8;
+	};
+	std::vector<Run> _runs;
+	/**Style arrays of the gap runs, in order.*/
+	std::vector<char*> _gaps;
+	unsigned _end;
+
+	/**Adds len positions of style as new runs.*/
+	void push(char style, unsigned len);
+};
@@ -17,29 +17,148 @@
 #include "StyleStream.h"
 #include <ILexer.h>
 #include <Scintilla.h>
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <Windows.h>
 
+namespace
+{
+	const LineStateTable::Entry NO_EXTENDED_STATE;
+}
+
 BaseSegmentedStream::BaseSegmentedStream(BaseSegmentedStream &stream)
 	: BaseSegmentedStream()
 {
 	_doc = stream._doc;
+	_lines = stream._lines;
+	_arena = stream._arena;
+	_lineIndex = stream._lineIndex;
+	_noFoldLevels = stream._noFoldLevels;
 	_baseFoldLevel = stream.foldLevel();
 }
 BaseSegmentedStream::~BaseSegmentedStream()
 {
 	//dumpFolds();
+	if (_ownsSections) delete[] _sections;
+}
+
+void BaseSegmentedStream::growSections()
+{
+	unsigned capacity = _sectionCapacity * 2;
+	Section *sections;
+	if (_arena) sections = static_cast<Section*>(_arena->allocate(capacity * sizeof(Section)));
+	else sections = new Section[capacity];
+	std::copy(_sections, _sections + _sectionCount, sections);
+	if (_ownsSections) delete[] _sections;
+	_sections = sections;
+	_sectionCapacity = capacity;
+	_ownsSections = !_arena;
+}
+unsigned BaseSegmentedStream::sectionAt(unsigned pos)const
+{
+	assert(pos < _length);
+	//Most lookaheads stay in the current section, or the one the last lookahead found
+	if (inSection(_section, pos)) return _section;
+	if (inSection(_peekSection, pos)) return _peekSection;
+	auto it = std::upper_bound(_sections, _sections + _sectionCount, pos,
+		[](unsigned pos, const Section &sec) { return pos < sec._start; });
+	_peekSection = (unsigned)(it - _sections) - 1;
+	return _peekSection;
+}
+int BaseSegmentedStream::peekSections(unsigned p)const
+{
+	unsigned pos = _sections[_section]._start + _pos + p;
+	if (pos >= _length) return -1;
+	unsigned section = sectionAt(pos);
+	return (unsigned char)_sections[section]._src[pos - _sections[section]._start];
+}
+bool BaseSegmentedStream::indexedLine(unsigned start, unsigned &line, unsigned &pos, unsigned &end)const
+{
+	if (!_lineIndex || _sectionCount != 1 || eof()) return false;
+	auto &sec = _sections[0];
+	if (_pos + start >= sec._len || !_lineIndex->contains(sec._src, sec._len)) return false;
+	unsigned base = (unsigned)(sec._src - _lineIndex->src());
+	pos = base + _pos + start;
+	end = base + sec._len;
+	line = _lineIndex->lineAt(pos);
+	return true;
+}
+bool BaseSegmentedStream::indexedLineLen(unsigned start, unsigned &len)const
+{
+	unsigned line, pos, end;
+	if (!indexedLine(start, line, pos, end)) return false;
+	//A sub stream may end part way through the line
+	len = (_lineIndex->lineEnd(line) < end ? _lineIndex->lineEnd(line) : end) - pos;
+	return true;
+}
+bool BaseSegmentedStream::indexedIndent(unsigned start, unsigned &indent)const
+{
+	unsigned line, pos, end;
+	if (!indexedLine(start, line, pos, end) || pos != _lineIndex->lineStart(line)) return false;
+	unsigned indentEnd = pos + _lineIndex->indent(line);
+	indent = (indentEnd < end ? indentEnd : end) - pos;
+	return true;
+}
+unsigned BaseSegmentedStream::findAny(const ByteSet &set, unsigned start)const
+{
+	if (eof()) return start;
+	unsigned base = _sections[_section]._start + _pos;
+	unsigned pos = base + start;
+	if (pos >= _length) return start;
+	for (unsigned section = sectionAt(pos); section < _sectionCount; ++section)
+	{
+		auto &sec = _sections[section];
+		const char *end = sec._src + sec._len;
+		const char *found = ::findAny(sec._src + (pos - _sections[section]._start), end, set);
+		pos = _sections[section]._start + (unsigned)(found - sec._src);
+		if (found != end) break;
+	}
+	return pos - base;
+}
+unsigned BaseSegmentedStream::countClass(CharClass mask, unsigned start)const
+{
+	if (eof()) return 0;
+	unsigned base = _sections[_section]._start + _pos + start;
+	if (base >= _length) return 0;
+	unsigned pos = base;
+	for (unsigned section = sectionAt(pos); section < _sectionCount; ++section)
+	{
+		auto &sec = _sections[section];
+		const char *end = sec._src + sec._len;
+		const char *found = ::skipClass(sec._src + (pos - sec._start), end, mask);
+		pos = sec._start + (unsigned)(found - sec._src);
+		if (found != end) break;
+	}
+	return pos - base;
+}
+StrView BaseSegmentedStream::peekView(unsigned start, unsigned len)const
+{
+	if (len == 0) return StrView();
+	assert(!eof());
+	unsigned pos = _sections[_section]._start + _pos + start;
+	assert(pos + len <= _length);
+	auto &sec = _sections[sectionAt(pos)];
+	unsigned offset = pos - sec._start;
+	if (offset + len <= sec._len) return StrView(sec._src + offset, len);
+	//Text split over sections, such as around a Ruby interpolation
+	StrView copy;
+	for (unsigned i = 0; i < len; ++i) copy.push_back((char)peek(start + i));
+	return copy;
 }
 
-void BaseSegmentedStream::advanceEol(char style)
+void BaseSegmentedStream::advanceEol(char style, unsigned state)
+{
+	advanceEol(style, state, NO_EXTENDED_STATE);
+}
+void BaseSegmentedStream::advanceEol(char style, unsigned state, const LineStateTable::Entry &extended)
 {
 	assert(!eof());
 	auto c = peek();
 	auto nextFold = _nextFold > 0 ? _nextFold : fold();
 	if (c == '\n')
 	{
-		_sections[_section]._styles[_pos] = style;
+		styleNext(style);
 		++_line;
 		++_pos;
 		nextSection();
@@ -47,32 +166,82 @@ void BaseSegmentedStream::advanceEol(char style)
 	else
 	{
 		assert(c == '\r');
-		_sections[_section]._styles[_pos] = style;
+		styleNext(style);
 		++_line;
 		++_pos;
 		nextSection();
 		if (peek() == '\n')
 		{
-			_sections[_section]._styles[_pos] = style;
+			styleNext(style);
 			++_pos;
 			nextSection();
 		}
 	}
 	_nextFold = 0;
+	if (_line >= _convergeLine && !eof())
+	{
+		_oldLineState = _lines->state((int)_line);
+		_oldFold = _noFoldLevels ? SC_FOLDLEVELBASE : _lines->level((int)_line);
+	}
 	fold(nextFold);
-	lineState(0);
+	lineState(state, extended);
+	if (_cancel && !eof() && _cancel->load(std::memory_order_relaxed))
+	{
+		_cancelled = true;
+		_section = _sectionCount;
+		_pos = 0;
+	}
 }
 
 void BaseSegmentedStream::lineState(unsigned state)
 {
-	if (_doc) _doc->SetLineState((int)_line, (int)state);
+	lineState(state, NO_EXTENDED_STATE);
+}
+void BaseSegmentedStream::lineState(unsigned state, const LineStateTable::Entry &extended)
+{
+	if (!_topLevel) return;
+	bool sameExtended = true;
+	if (_extendedStates)
+	{
+		sameExtended = _extendedStates->get(_line) == extended;
+		if (!sameExtended) _extendedStates->set(_line, extended);
+	}
+	_lines->state((int)_line, (int)state);
+	if (_line >= _convergeLine && !eof() && state != 0 && (int)state == _oldLineState && sameExtended &&
+		(fold() & SC_FOLDLEVELNUMBERMASK) == (_oldFold & SC_FOLDLEVELNUMBERMASK))
+	{
+		//Everything from here will style the same as last time, so stop. The header flag
+		//depends on the rest of the line or later lines, so keep the old one.
+		assert(_section == 0);
+		if (!_noFoldLevels) _lines->level((int)_line, _oldFold);
+		_convergePos = _pos;
+		_section = _sectionCount;
+		_pos = 0;
+	}
+	else if (_section == 0 && _pos >= _yieldAfter && _pos > 0 && !eof() && state != 0)
+	{
+		//The lexer can carry on from this lines state, so leave the rest for later
+		_yieldPos = _pos;
+		_section = _sectionCount;
+		_pos = 0;
+	}
+}
+unsigned BaseSegmentedStream::lineState()const
+{
+	if (!_topLevel || _line == 0) return 0;
+	return (unsigned)_lines->state((int)_line);
+}
+const LineStateTable::Entry &BaseSegmentedStream::extendedLineState()const
+{
+	if (!_topLevel || !_extendedStates || _line == 0) return NO_EXTENDED_STATE;
+	return _extendedStates->get(_line);
 }
 void BaseSegmentedStream::fold(int line, int level)
 {
-	if (_doc)
+	if (_lines && !_noFoldLevels)
 	{
 		level += _baseFoldLevel;
-		_doc->SetLevel(line, level);
+		_lines->level(line, level);
 	}
 }
 void BaseSegmentedStream::foldHeader(int line, int level)
@@ -85,7 +254,7 @@ void BaseSegmentedStream::foldNext(int level)
 }
 int BaseSegmentedStream::fold()
 {
-	return _doc ? (_doc->GetLevel((int)_line) - _baseFoldLevel) : SC_FOLDLEVELBASE;
+	return _lines && !_noFoldLevels ? (_lines->level((int)_line) - _baseFoldLevel) : SC_FOLDLEVELBASE;
 }
 int BaseSegmentedStream::foldLevel()
 {
@@ -93,6 +262,7 @@ int BaseSegmentedStream::foldLevel()
 }
 void BaseSegmentedStream::relFoldNext(int levels)
 {
+	if (_noFoldLevels) return;
 	int current = _nextFold ? _nextFold : (fold() & SC_FOLDLEVELNUMBERMASK);
 	int currentLevel = (current & SC_FOLDLEVELNUMBERMASK) - SC_FOLDLEVELBASE;
 	int newLevel = currentLevel + levels;
@@ -101,9 +271,9 @@ void BaseSegmentedStream::relFoldNext(int levels)
 }
 void BaseSegmentedStream::foldIndent(int indent)
 {
-	if (_line > 0)
+	if (_line > 0 && _lines && !_noFoldLevels)
 	{
-		auto prev = _doc->GetLevel(_line - 1);
+		auto prev = _lines->level((int)_line - 1);
 		if ((prev & SC_FOLDLEVELNUMBERMASK) - SC_FOLDLEVELBASE < indent)
 		{
 			fold(_line - 1, prev | SC_FOLDLEVELHEADERFLAG);
@@ -129,45 +299,93 @@ void BaseSegmentedStream::dumpFolds()
 }
 
 DocumentStyleStream::DocumentStyleStream(IDocument *doc)
-	: StyleStream(), _startPos(0)
+	: DocumentStyleStream(doc, 0, (unsigned)doc->Length())
 {
-	_doc = doc;
-	unsigned len = (unsigned)doc->Length();
-	std::unique_ptr<char[]> src(new char[len]);
-	std::unique_ptr<char[]> styles(new char[len]);
-	doc->GetCharRange(src.get(), 0, (int)len);
-
-	addSection(src.get(), styles.get(), len, 0);
-	src.release();
-	styles.release();
-
-	fold(SC_FOLDLEVELBASE);
 }
-DocumentStyleStream::DocumentStyleStream(IDocument *doc, unsigned line, unsigned len)
-	: StyleStream(), _startPos(0)
+DocumentStyleStream::DocumentStyleStream(IDocument *doc, unsigned line, unsigned len, const char *text,
+	StreamBuffers *buffers)
+	: StyleStream(), _startPos(0), _ownsSrc(!text), _buffers(buffers), _lineBuffer(doc, (int)line)
 {
 	_doc = doc;
+	_lines = &_lineBuffer;
+	if (_buffers) _arena = &_buffers->arena();
+	_topLevel = true;
 	_line = line;
 	_startPos = (unsigned)doc->LineStart((int)line);
 
-	std::unique_ptr<char[]> src(new char[len]);
-	std::unique_ptr<char[]> styles(new char[len]);
-	doc->GetCharRange(src.get(), (int)_startPos, (int)len);
-
-	addSection(src.get(), styles.get(), len, line);
-	src.release();
-	styles.release();
+	if (len > 0 && _buffers)
+	{
+		const char *src;
+		if (text) src = text;
+		else
+		{
+			char *copy = _buffers->src(len);
+			doc->GetCharRange(copy, (int)_startPos, (int)len);
+			src = copy;
+		}
+		//The styles are written in order, so keep them as runs instead of a document sized array
+		_runs = &_buffers->runs();
+		_runs->clear();
+		addSection(src, nullptr, len, line);
+		_lineIndex = &_buffers->lineIndex();
+		_lineIndex->reset(src, len);
+	}
+	else if (len > 0)
+	{
+		std::unique_ptr<char[]> styles(new char[len]()); //anything the lexer skips is left as default
+		if (text)
+		{
+			addSection(text, styles.get(), len, line);
+		}
+		else
+		{
+			std::unique_ptr<char[]> src(new char[len]);
+			doc->GetCharRange(src.get(), (int)_startPos, (int)len);
+			addSection(src.get(), styles.get(), len, line);
+			src.release();
+		}
+		styles.release();
+	}
 
-	if (_line > 0) fold(_doc->GetLevel(_line - 1));
+	//The level of a line is set when the previous line is styled, only the header flag
+	//depends on the lines content
+	if (_line > 0) fold(_lines->level((int)_line) & ~SC_FOLDLEVELHEADERFLAG);
 	else fold(SC_FOLDLEVELBASE);
 }
 DocumentStyleStream::~DocumentStyleStream()
 {
-	assert(_sections.size() == 1);
+	assert(_sectionCount <= 1);
+	_lineBuffer.flush();
+	if (_sectionCount == 0) return;
 
-	_doc->StartStyling(_startPos, (char)0xFF);
-	_doc->SetStyles((int)_sections[0]._len, _sections[0]._styles);
+	if (!cancelled())
+	{
+		//The lines after a yield are left unstyled, so the next Lex starts from there
+		unsigned len = yielded() ? _yieldPos : _sections[0]._len;
+		//The lines after converging keep their styles. SetStyles itself only reports the
+		//styles that changed.
+		unsigned last = converged() ? _convergePos : len;
+		if (_runs)
+		{
+			//Anything the lexer skipped is left as default
+			if (_runs->end() > last) _runs->cut(last);
+			else _runs->add(0, last - _runs->end());
+			_doc->StartStyling((int)_startPos, (char)0xFF);
+			_runs->write(_doc, last);
+		}
+		else if (last > 0)
+		{
+			_doc->StartStyling((int)_startPos, (char)0xFF);
+			_doc->SetStyles((int)last, _sections[0]._styles);
+		}
+		//Scintilla takes everything before the styling position as styled
+		_doc->StartStyling((int)(_startPos + len), (char)0xFF);
+	}
 
-	delete[] _sections[0]._src;
-	delete[] _sections[0]._styles;
+	if (_buffers) _buffers->release();
+	else
+	{
+		if (_ownsSrc) delete[] _sections[0]._src;
+		delete[] _sections[0]._styles;
+	}
 }
\ No newline at end of file
@@ -17,14 +17,24 @@
 #pragma once
 #include <memory>
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <functional>
 #include <vector>
+#include <atomic>
+#include "LineStateTable.h"
+#include "CharScan.h"
+#include "LineIndex.h"
+#include "SectionArena.h"
+#include "StreamBuffers.h"
+#include "StyleRuns.h"
+#include "StrView.h"
+#include "LineBuffer.h"
 class IDocument; //Scintilla
 
 inline bool isAlphaNumeric(int c)
 {
-	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	return charIs(c, CHAR_ALNUM);
 }
 
 /**Provides the basic access to style a document as a series of segments.
@@ -34,51 +44,60 @@ class BaseSegmentedStream
 {
 public:
 	BaseSegmentedStream()
-		: _sections(), _section(0), _pos(0), _line(0), _doc(nullptr)
-		, _baseFoldLevel(0), _nextFold(0) {}
+		: _inlineSections(), _sections(_inlineSections), _sectionCount(0), _sectionCapacity(INLINE_SECTIONS)
+		, _ownsSections(false), _arena(nullptr), _lineIndex(nullptr), _endLine((unsigned)-1)
+		, _length(0), _peekSection(0), _runs(nullptr)
+		, _section(0), _pos(0), _line(0), _doc(nullptr), _lines(nullptr), _topLevel(false)
+		, _convergeLine((unsigned)-1), _convergePos((unsigned)-1), _oldLineState(0), _oldFold(0)
+		, _yieldAfter((unsigned)-1), _yieldPos((unsigned)-1), _cancel(nullptr), _cancelled(false)
+		, _extendedStates(nullptr)
+		, _baseFoldLevel(0), _nextFold(0), _noFoldLevels(false) {}
 	explicit BaseSegmentedStream(BaseSegmentedStream &stream);
 
 	~BaseSegmentedStream();
 
 	bool eof()const
 	{
-		return _section >= _sections.size();
+		return _section >= _sectionCount;
 	}
 	int peek(unsigned p = 0)const
 	{
 		if (eof()) return -1;
-
-		int section = _section;
-		int pos = _pos;
-		unsigned i = 0;
-		while (true)
+		if (_sectionCount == 1)
 		{
-			if (pos == _sections[section]._len)
-			{
-				++section;
-				pos = 0;
-			}
-			if (section >= (int)_sections.size()) return -1;
-			if (i == p) break;
-			++i;
-			++pos;
+			//A stream over a single range of the document
+			unsigned i = _pos + p;
+			return i < _sections[0]._len ? (unsigned char)_sections[0]._src[i] : -1;
 		}
-		return (unsigned char)_sections[section]._src[pos];
+		return peekSections(p);
 	}
+	/**Finds the first element from start that is in set.
+	 * @return Offset of the element, or of the end of the stream.
+	 */
+	unsigned findAny(const ByteSet &set, unsigned start = 0)const;
+	/**Counts the elements from start that are in one of the classes in mask.*/
+	unsigned countClass(CharClass mask, unsigned start = 0)const;
+	/**Get the len elements from start, which must not be past the end of the stream.*/
+	StrView peekView(unsigned start, unsigned len)const;
 	int last()const
 	{
-		if (_sections.empty() || _sections.back()._len == 0) return -1;
-		auto &sec = _sections.back();
+		if (_sectionCount == 0 || _sections[_sectionCount - 1]._len == 0) return -1;
+		auto &sec = _sections[_sectionCount - 1];
 		return (unsigned char)sec._src[sec._len - 1];
 	}
 	/**Style EOL and update line number.
+	 *
+	 * The stream ends after the line end if it converges, yields or is cancelled, so callers
+	 * that cross several line ends must stop at eof.
 	 *
 	 * If _nextFold is positive then then newline will use that and set _nextFold to 0
 	 * otherwise the new line will copy the line folding from the previous line.
 	 *
-	 * The newlines state is set to 0.
+	 * The newlines state is set to state, see lineState.
 	 */
-	void advanceEol(char style = 0);
+	void advanceEol(char style = 0, unsigned state = 0);
+	/**Style EOL, and set the new lines state including an extended state, see lineState.*/
+	void advanceEol(char style, unsigned state, const LineStateTable::Entry &extended);
 	unsigned eolLen(unsigned start = 0)const
 	{
 		auto c = peek(start);
@@ -88,35 +107,57 @@ public:
 		if (peek(start + 1) == '\n') return 2; //\r\n
 		return 1; //\r
 	}
-	/**Style next n elements.*/
+	/**Style next n elements, which must not include a line end.*/
 	void advance(char style, size_t n = 1)
 	{
-		for (size_t i = 0; i < n; ++i)
+		while (n > 0)
 		{
 			assert(!eof());
-			assert(peek() != '\r' && peek() != '\n');
-			_sections[_section]._styles[_pos] = (char)style;
-			++_pos;
+			auto &sec = _sections[_section];
+			unsigned run = sec._len - _pos;
+			if (n < run) run = (unsigned)n;
+			assert(!memchr(sec._src + _pos, '\r', run) && !memchr(sec._src + _pos, '\n', run));
+			if (_runs) _runs->add(style, run);
+			else memset(sec._styles + _pos, style, run);
+			_pos += run;
+			n -= run;
 			nextSection();
 		}
 	}
 
+	/**Add the next len elements of stream as sections of this one, and skip them in stream.
+	 * Text that directly follows the previous section is added to it, rather than as a new
+	 * section.
+	 */
 	void addSection(BaseSegmentedStream &stream, unsigned len)
 	{
-		while (len > 0)
+		if (!_arena) _arena = stream._arena;
+		if (!_lineIndex) _lineIndex = stream._lineIndex;
+		//stream may stop at a line end in len, see advanceEol
+		while (len > 0 && !stream.eof())
 		{
-			assert(!stream.eof());
 			const auto &sec = stream._sections[stream._section];
-			Section newSec = {sec._src + stream._pos, sec._styles + stream._pos, 0, stream._line};
+			Section newSec = {sec._src + stream._pos, nullptr, 0, stream._line, 0};
 			unsigned remaining = sec._len - stream._pos;
 			if (len <= remaining) newSec._len = len;
 			else newSec._len = remaining;
+			if (stream._runs)
+			{
+				//A stream keeping StyleRuns has no style array, so the text gets its own
+				newSec._styles = static_cast<char*>(stream._arena->allocate(newSec._len));
+				memset(newSec._styles, 0, newSec._len);
+			}
+			else newSec._styles = sec._styles + stream._pos;
 
 			assert(newSec._len > 0 && newSec._len <= len);
-			_sections.push_back(newSec);
-			stream.skip(newSec._len);
+			if (!appendSection(newSec))
+			{
+				pushSection(newSec);
+				if (_sectionCount == 1) _line = newSec._line;
+			}
+			stream.skip(newSec._len, newSec._styles);
+			_endLine = stream._line;
 			len -= newSec._len;
-			if (_sections.size() == 1) _line = newSec._line;
 		}
 	}
 	/**Set the base fold level. All calls to the fold related methods will have this added or
@@ -124,8 +165,25 @@ public:
 	 */
 	void baseFoldLevel(int level) { _baseFoldLevel = level; }
 
-	/**Set the persistant state for the current line.*/
+	/**Set the persistant state for the current line.
+	 * Only the top level document stream records line states, sub streams for embedded
+	 * languages ignore this.
+	 *
+	 * A non-zero state that matches the lines previous state may end the stream, see
+	 * DocumentStyleStream::convergeFrom. Any non-zero state may end it once it is past
+	 * DocumentStyleStream::yieldAfter.
+	 */
 	void lineState(unsigned state);	//fold current line
+	/**Set the persistant state for the current line, with extra state that does not fit in
+	 * 32 bits, stored in the lexers LineStateTable.
+	 */
+	void lineState(unsigned state, const LineStateTable::Entry &extended);
+	/**Get the state the current line had when it was last styled, so a lexer can resume a
+	 * multi-line construct. Always 0 on the first line and for sub streams.
+	 */
+	unsigned lineState()const;
+	/**Get the extended state set with lineState for the current line, empty if there is none.*/
+	const LineStateTable::Entry &extendedLineState()const;
 	/**Get the current line number.*/
 	int line()const { return _line; }
 	void fold(int line, int level);
@@ -165,12 +223,15 @@ protected:
 	{
 		if (len > 0)
 		{
-			Section newSec = {src, styles, len, line};
-			_sections.push_back(newSec);
+			Section newSec = {src, styles, len, line, 0};
+			pushSection(newSec);
+			_endLine = (unsigned)-1;
 		}
 	}
 private:
-	//TODO: For ~DocumentStyleStream
+	/**DocumentStyleStream creates the section over the document text, and writes its styles
+	 * to the document when it is destroyed.
+	 */
 	friend class DocumentStyleStream;
 
 	struct Section
@@ -180,8 +241,33 @@ private:
 		unsigned _len;
 		/**First line number.*/
 		unsigned _line;
+		/**Position from the start of the stream, to find the section for a peek with a binary
+		 * search.
+		 */
+		unsigned _start;
 	};
-	std::vector<Section> _sections;
+	/**Sections stored in the stream itself, enough for most sub streams without allocating.*/
+	static const unsigned INLINE_SECTIONS = 4;
+	Section _inlineSections[INLINE_SECTIONS];
+	/**_inlineSections, or a larger array from _arena or new[].*/
+	Section *_sections;
+	unsigned _sectionCount, _sectionCapacity;
+	/**True if _sections was allocated with new[].*/
+	bool _ownsSections;
+	/**Arena of the DocumentStyleStream, for sections past INLINE_SECTIONS, or null.*/
+	SectionArena *_arena;
+	/**Index of the lines of the DocumentStyleStream text, or null.*/
+	LineIndex *_lineIndex;
+	/**Line number at the end of the last section added from another stream, or -1.*/
+	unsigned _endLine;
+	/**Total length of _sections.*/
+	unsigned _length;
+	/**Section found by the last peekSections, tried before searching.*/
+	mutable unsigned _peekSection;
+	/**Where the top level stream keeps its styles if it has no style array, else null. Its
+	 * sections _styles are then null, and sub streams get their own styles, see addSection.
+	 */
+	StyleRuns *_runs;
 	/**Current position in _sections.*/
 	unsigned _section;
 	/**Current position in _sections[_section] _src and _styles.*/
@@ -189,11 +275,83 @@ private:
 	/**Current document line number.*/
 	unsigned _line;
 	IDocument *_doc;
+	/**Fold levels and line states of the top level stream, shared with its sub streams.*/
+	LineBuffer *_lines;
+	/**True for the stream directly over the document, which owns the line states.*/
+	bool _topLevel;
+	/**First line that lineState may stop the stream on.*/
+	unsigned _convergeLine;
+	/**Position in the first section the stream stopped at, or -1.*/
+	unsigned _convergePos;
+	/**Line state and fold level the current line had before it was restyled.*/
+	int _oldLineState, _oldFold;
+	/**Position in the first section after which lineState may stop the stream, or -1.*/
+	unsigned _yieldAfter;
+	/**Position in the first section the stream yielded at, or -1.*/
+	unsigned _yieldPos;
+	/**Flag checked at each line end, to abandon styling, or null.*/
+	const std::atomic<bool> *_cancel;
+	bool _cancelled;
+	/**Extended line states, only for the top level stream.*/
+	LineStateTable *_extendedStates;
 	int _baseFoldLevel;
 	/**Fold level to use for the next line.
 	 * See advanceEol
 	 */
 	int _nextFold;
+	/**True if fold levels are not set or read, see DocumentStyleStream::noFoldLevels.*/
+	bool _noFoldLevels;
+	void pushSection(const Section &section)
+	{
+		if (_sectionCount == _sectionCapacity) growSections();
+		Section &sec = _sections[_sectionCount++];
+		sec = section;
+		sec._start = _length;
+		_length += section._len;
+	}
+	/**Doubles _sectionCapacity.*/
+	void growSections();
+	/**Extends the last section with section if it directly follows it in both the source and
+	 * styles, and starts on the line the last section ends on.
+	 * @return False if section must be added as a new section.
+	 */
+	bool appendSection(const Section &section)
+	{
+		if (_sectionCount == 0 || section._line != _endLine) return false;
+		Section &last = _sections[_sectionCount - 1];
+		if (last._src + last._len != section._src || last._styles + last._len != section._styles)
+		{
+			return false;
+		}
+		last._len += section._len;
+		_length += section._len;
+		return true;
+	}
+	/**True if the stream position pos is in section.*/
+	bool inSection(unsigned section, unsigned pos)const
+	{
+		return section < _sectionCount && pos >= _sections[section]._start &&
+			pos - _sections[section]._start < _sections[section]._len;
+	}
+	/**Finds the section containing the stream position pos, which must be before _length.*/
+	unsigned sectionAt(unsigned pos)const;
+	/**peek for streams with more than one section.*/
+	int peekSections(unsigned p)const;
+protected:
+	/**Gets lineLen(start) from the DocumentStyleStream LineIndex, if the stream is a single
+	 * section of the indexed text and start is before its end.
+	 */
+	bool indexedLineLen(unsigned start, unsigned &len)const;
+	/**Gets peekNextIndent(start) from the LineIndex, if start is the start of a line, see
+	 * indexedLineLen.
+	 */
+	bool indexedIndent(unsigned start, unsigned &indent)const;
+private:
+	/**Finds the line of _lineIndex containing start, see indexedLineLen.
+	 * @param pos Set to the position of start in the indexed text.
+	 * @param end Set to the position of the end of the stream in the indexed text.
+	 */
+	bool indexedLine(unsigned start, unsigned &line, unsigned &pos, unsigned &end)const;
 	/**Moves to next _section if _pos reached the end.*/
 	void nextSection()
 	{
@@ -210,12 +368,22 @@ private:
 			}
 		}
 	}
-	/**Advance without styling. Used when creating sub streams for other languages.*/
-	void skip(unsigned n = 1)
+	/**Styles the element at the current position.*/
+	void styleNext(char style)
 	{
-		for (unsigned i = 0; i < n;)
+		if (_runs) _runs->add(style, 1);
+		else _sections[_section]._styles[_pos] = style;
+	}
+	/**Advance without styling. Used when creating sub streams for other languages.
+	 * @param styles The styles of the skipped text, kept as a gap if there are _runs.
+	 */
+	void skip(unsigned n, char *styles)
+	{
+		unsigned start = _pos;
+		unsigned i = 0;
+		//A line end may stop the stream, see advanceEol
+		while (i < n && !eof())
 		{
-			assert(!eof());
 			char c = peek();
 			if (c == '\r' || c == '\n')
 			{
@@ -230,6 +398,12 @@ private:
 				nextSection();
 			}
 		}
+		if (_runs)
+		{
+			//The line ends styled by advanceEol are part of the gap
+			_runs->cut(start);
+			_runs->addGap(styles, i);
+		}
 	}
 };
 
@@ -259,39 +433,24 @@ public:
 		addSection(stream, stream.fullLineLen());
 	}
 
-	std::string peekStr(unsigned len)const
+	StrView peekStr(unsigned len)const
 	{
-		std::string ret;
-		ret.reserve(len);
-		for (unsigned i = 0; i < len; ++i)
-		{
-			auto c = peek(i);
-			assert(c >= 0);
-			ret.push_back((char)c);
-		}
-		return ret;
+		return peekView(0, len);
 	}
+	/**Get the elements from start for which f is true.*/
 	template<typename F>
-	std::string peekStr(F f, unsigned start = 0)const
+	StrView peekStr(F f, unsigned start = 0)const
 	{
-		std::string ret;
-		unsigned p = 0;
-		while (true)
-		{
-			auto c = peek(p + start);
-			if (c < 0 || !f((char)c)) return ret;
-			ret.push_back((char)c);
-			++p;
-		}
+		return peekView(start, countMatches(f, start));
+	}
+	/**Get the elements from start that are in one of the classes in mask.*/
+	StrView peekStr(CharClass mask, unsigned start = 0)const
+	{
+		return peekView(start, countClass(mask, start));
 	}
 	int peekAfterSpTab(unsigned start)
 	{
-		while (true)
-		{
-			auto c = peek(start);
-			if (c == ' ' || c == '\t') ++start;
-			else return c;
-		}
+		return peek(start + countClass(CHAR_SPACE, start));
 	}
 
 
@@ -319,13 +478,8 @@ public:
 	unsigned peekNextIndent(unsigned start = 0)const
 	{
 		unsigned p = 0;
-		while (true)
-		{
-			auto c = peek(p + start);
-			if (c == ' ' || c == '\t') ++p;
-			else break;
-		}
-		return p;
+		if (indexedIndent(start, p)) return p;
+		return countClass(CHAR_SPACE, start);
 	}
 	unsigned countChr(char c, unsigned start = 0)const
 	{
@@ -334,7 +488,7 @@ public:
 		return p;
 	}
 	template<typename F>
-	unsigned countMatches(F f, unsigned start = 0)
+	unsigned countMatches(F f, unsigned start = 0)const
 	{
 		unsigned p = 0;
 		while (true)
@@ -344,28 +498,25 @@ public:
 			else ++p;
 		}
 	}
+	unsigned countMatches(CharClass mask, unsigned start = 0)const
+	{
+		return countClass(mask, start);
+	}
 	bool isWsAt(unsigned p)const
 	{
-		auto c = peek(p);
-		return c == ' ' || c == '\t';
+		return charIs(peek(p), CHAR_SPACE);
 	}
 	bool lineContains(char c, unsigned p = 0)const
 	{
-		while (true)
-		{
-			auto c2 = peek(p++);
-			if (c2 < 0 || c2 == '\r' || c2 == '\n') return false;
-			if (c2 == c) return true;
-		}
+		ByteSet set("\r\n");
+		set.add(c);
+		auto c2 = peek(findAny(set, p));
+		return c2 >= 0 && c2 != '\r' && c2 != '\n';
 	}
 	bool isBlankLine(unsigned start = 0)const
 	{
-		while (true)
-		{
-			auto c = peek(start++);
-			if (c < 0 || c == '\r' || c == '\n') return true;
-			if (c != ' ' && c != '\t') return false;
-		}
+		auto c = peek(start + countClass(CHAR_SPACE, start));
+		return c < 0 || c == '\r' || c == '\n';
 	}
 
 	bool peekEol(unsigned start = 0)const
@@ -375,14 +526,10 @@ public:
 	}
 	unsigned lineLen(unsigned start = 0)const
 	{
-		unsigned p = start;
-		while (true)
-		{
-			auto c2 = peek(p);
-			if (c2 < 0 || c2 == '\r' || c2 == '\n') break;
-			++p;
-		}
-		return p - start;
+		static const ByteSet EOL("\r\n");
+		unsigned len;
+		if (indexedLineLen(start, len)) return len;
+		return findAny(EOL, start) - start;
 	}
 	unsigned fullLineLen(unsigned start = 0)const
 	{
@@ -390,22 +537,19 @@ public:
 		return n + eolLen(start + n);
 	}
 	//style
-	/**Style rest of line.*/
-	void advanceLine(char style, char eolStyle = 0)
+	/**Style rest of line, and set the state of the next line.*/
+	void advanceLine(char style, char eolStyle = 0, unsigned state = 0)
 	{
-		while (true)
-		{
-			auto c = peek();
-			if (c < 0) return;
-			else if (c == '\r' || c == '\n') return advanceEol(style);
-			else advance(style);
-		}
+		advance(style, lineLen());
+		if (peek() >= 0) advanceEol(style, state);
 	}
+	/**Style the next n elements, including line ends.
+	 * Stops early if a line end stops the stream, see advanceEol.
+	 */
 	void advanceWithEol(char style, unsigned n = 1)
 	{
-		for (unsigned i = 0; i < n;)
+		for (unsigned i = 0; i < n && !eof();)
 		{
-			assert(!eof());
 			if (peek() == '\r' || peek() == '\n')
 			{
 				i += eolLen();
@@ -422,33 +566,13 @@ public:
 	/**Style ' ' and '\t'*/
 	void advanceSpTab(char style = 0)
 	{
-		while (true)
-		{
-			switch (peek())
-			{
-			case ' ':
-			case '\t':
-				advance(style);
-				break;
-			default:
-				return;
-			}
-		}
+		advance(style, peekNextIndent());
 	}
 	/**Style ' ' and '\t' and return the count.*/
 	unsigned advanceIndent(char style = 0)
 	{
-		unsigned n = 0;
-		while (true)
-		{
-			auto c = peek();
-			if (c == ' ' || c == '\t')
-			{
-				++n;
-				advance(style);
-			}
-			else break;
-		}
+		unsigned n = peekNextIndent();
+		advance(style, n);
 		return n;
 	}
 	/**Style ' ', '\t' and blank lines, and return the next indent count.*/
@@ -484,12 +608,11 @@ public:
 	template<typename F>
 	void advanceMatches(F f, char style)
 	{
-		while (true)
-		{
-			auto c = peek();
-			if (c < 0 || !f((char)c)) return;
-			else advance(style);
-		}
+		advance(style, countMatches(f));
+	}
+	void advanceMatches(CharClass mask, char style)
+	{
+		advance(style, countClass(mask));
 	}
 protected:
 };
@@ -499,8 +622,57 @@ class DocumentStyleStream : public StyleStream
 {
 public:
 	DocumentStyleStream(IDocument *doc);
-	DocumentStyleStream(IDocument *doc, unsigned line, unsigned len);
+	/**Stream over len characters from the start of line.
+	 * @param text The text from the start of line to read in place rather than copying it
+	 * with IDocument::GetCharRange, such as a DocumentSnapshot buffer, or null. It must not
+	 * change while the stream is used.
+	 * @param buffers Buffers to use rather than allocating new ones, which must outlive the
+	 * stream. Their LineIndex is used to find line lengths and indents for this stream and
+	 * its sub streams.
+	 */
+	DocumentStyleStream(IDocument *doc, unsigned line, unsigned len, const char *text = nullptr,
+		StreamBuffers *buffers = nullptr);
 	~DocumentStyleStream();
+
+	/**Allow the stream to stop on a line from this one when it gets the same line state and
+	 * fold level it had before. The rest of the stream then keeps its existing styles.
+	 *
+	 * The caller must ensure the text from line onwards is unchanged since it was styled.
+	 */
+	void convergeFrom(unsigned line) { _convergeLine = line; }
+	/**True if the stream was stopped early by convergeFrom.*/
+	bool converged()const { return _convergePos != (unsigned)-1; }
+	/**Document position of the line styling stopped on, if converged.*/
+	unsigned convergedPos()const { return _startPos + _convergePos; }
+	/**Allow the stream to stop on the first line after len characters that has a non-zero line
+	 * state, so a long restyle can be split up. A later DocumentStyleStream from that line
+	 * continues exactly where this one left off, as the lexer resumes from the line state.
+	 *
+	 * Only the styles before that line are written to the document.
+	 */
+	void yieldAfter(unsigned len) { _yieldAfter = len; }
+	/**True if the stream was stopped early by yieldAfter.*/
+	bool yielded()const { return _yieldPos != (unsigned)-1; }
+	/**Document position of the line styling stopped on, if yielded.*/
+	unsigned yieldedPos()const { return _startPos + _yieldPos; }
+	/**Stop the stream at the next line end once the flag is set, e.g. by another thread when
+	 * the text has changed. No styles are written to the document, only the line states and
+	 * fold levels up to that line, which are correct for the text that was styled.
+	 */
+	void cancelOn(const std::atomic<bool> *flag) { _cancel = flag; }
+	/**True if the stream was stopped by cancelOn.*/
+	bool cancelled()const { return _cancelled; }
+	/**Set the table to store extended line states in.*/
+	void extendedLineStates(LineStateTable *table) { _extendedStates = table; }
+	/**Do not set fold levels, for when nothing uses them. The fold methods do nothing and
+	 * foldLevel is always 0, so only lexers whose styling does not depend on it can use this.
+	 * The stream may still converge, on the line state alone.
+	 */
+	void noFoldLevels() { _noFoldLevels = true; }
 private:
 	unsigned _startPos;
+	/**False if the source text is the documents own buffer.*/
+	bool _ownsSrc;
+	StreamBuffers *_buffers;
+	LineBuffer _lineBuffer;
 };
@@ -0,0 +1,86 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#include "WordList.h"
+#include <cstring>
+
+namespace
+{
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+}
+
+WordList::WordList()
+	: _words(), _table(), _count(0)
+{
+}
+WordList::WordList(const char *words)
+	: _words(), _table(), _count(0)
+{
+	std::vector<unsigned> starts;
+	while (true)
+	{
+		while (isSpace(*words)) ++words;
+		if (!*words) break;
+		const char *end = words;
+		while (*end && !isSpace(*end)) ++end;
+		starts.push_back((unsigned)_words.size());
+		_words.append(words, end);
+		_words.push_back('\0');
+		words = end;
+	}
+
+	//At most half full, so probe sequences stay short
+	size_t size = 8;
+	while (size < starts.size() * 2) size *= 2;
+	_table.assign(size, 0);
+	for (auto start : starts)
+	{
+		const char *word = _words.c_str() + start;
+		unsigned len = (unsigned)strlen(word);
+		if (contains(word, len)) continue;
+		size_t i = hash(word, len) & (size - 1);
+		while (_table[i]) i = (i + 1) & (size - 1);
+		_table[i] = start + 1;
+		++_count;
+	}
+}
+
+bool WordList::contains(const char *word, unsigned len)const
+{
+	if (_table.empty()) return false;
+	size_t mask = _table.size() - 1;
+	for (size_t i = hash(word, len) & mask; _table[i]; i = (i + 1) & mask)
+	{
+		const char *entry = _words.c_str() + _table[i] - 1;
+		if (strncmp(entry, word, len) == 0 && entry[len] == '\0') return true;
+	}
+	return false;
+}
+
+unsigned WordList::hash(const char *word, unsigned len)
+{
+	//FNV-1a
+	unsigned h = 2166136261u;
+	for (unsigned i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)word[i];
+		h *= 16777619u;
+	}
+	return h;
+}
@@ -0,0 +1,50 @@
+// This file is part of Extra Languages for Notepad++.
+// Copyright (C) 2016 William Newbery <wnewbery@hotmail.co.uk>
+//
+// This program is free software : you can redistribute it and / or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include "StrView.h"
+#include <string>
+#include <vector>
+
+/**A set of words from a Scintilla word list, such as the keywords Notepad++ users can add to
+ * with the Style Configurator.
+ *
+ * The words are hashed into an open addressing table once when the list is set, so a lookup
+ * is a hash of the token and usually a single compare, however long the list is. A WordList is
+ * not changed after it is built, so one can be shared by lexers on different threads.
+ */
+class WordList
+{
+public:
+	WordList();
+	/**List of the words in a string, separated by whitespace.*/
+	explicit WordList(const char *words);
+
+	bool empty()const { return _count == 0; }
+	bool contains(const char *word, unsigned len)const;
+	bool contains(const StrView &word)const { return contains(word.data(), word.size()); }
+	/**True if both lists have the same words in the same order.*/
+	bool operator==(const WordList &other)const { return _words == other._words; }
+	bool operator!=(const WordList &other)const { return !(*this == other); }
+private:
+	/**The words, each followed by a null.*/
+	std::string _words;
+	/**Position of a word in _words plus 1 for each used slot, else 0. Size is a power of 2.*/
+	std::vector<unsigned> _table;
+	unsigned _count;
+
+	static unsigned hash(const char *word, unsigned len);
+};
@@ -30,15 +30,11 @@ namespace
 		while (true)
 		{
 			char c = stream.peek();
-			if (c == '\n')
+			if (c == '\r' || c == '\n')
 			{
 				stream.advanceEol();
 				indent = 0;
 			}
-			else if (c == '\r')
-			{
-				stream.advanceEol();
-			}
 			else if (c == ' ' || c == '\t')
 			{
 				stream.advance(0);
@@ -49,26 +45,55 @@ namespace
 	}
 }
 
+void Haml::setWordList(int n, const std::shared_ptr<const WordList> &list)
+{
+	BaseLexer::setWordList(n, list);
+	if (n == HTML_NAMES) html.setWordList(Html::NAMES, list);
+	else if (n == RUBY_KEYWORDS) ruby.setWordList(Ruby::KEYWORDS, list);
+	else if (n == RUBY_BUILTINS) ruby.setWordList(Ruby::BUILTINS, list);
+}
+
 void Haml::style(StyleStream &stream)
 {
-	//TODO: If start of document
-	if (stream.matches("!!!"))
+	auto state = stream.lineState();
+	if (state & ~SAFE_START) resume(stream, state);
+	else
 	{
-		stream.advanceLine(DOCTYPE);
+		if (stream.line() == 0 && stream.matches("!!!"))
+		{
+			stream.advanceLine(DOCTYPE);
+		}
+		_currentIndent = nextIndent(stream);
 	}
-	//Potentially, this could deal with only re-styling the required subsection
-	//This would be a case of positioning stream on the first start line before the edited position
-	//then stopping the loop on the next unaltered line after
-	_currentIndent = nextIndent(stream);
 	while (!stream.eof())
 	{
 		line(stream);
 	}
 }
+unsigned Haml::attrsState(LineContext context, int depth)const
+{
+	if (depth > 0xFF || _currentIndent > 0xFFFFF) return 0;
+	return SAFE_START | ((unsigned)context << 1) | ((unsigned)depth << 3) | (_currentIndent << 11);
+}
+void Haml::resume(StyleStream &stream, unsigned state)
+{
+	_currentIndent = (state >> 11) & 0xFFFFF;
+	int depth = (int)((state >> 3) & 0xFF);
+	switch ((state >> 1) & 3)
+	{
+	case RUBY_ATTRS: return rubyAttrsBody(stream, depth, true);
+	case HTML_ATTRS: return htmlAttrsBody(stream, depth);
+	default:
+		assert(false);
+		_currentIndent = nextIndent(stream);
+		return;
+	}
+}
 void Haml::line(StyleStream &stream)
 {
-	if (stream.eof()) return; //nothing todo
 	stream.foldIndent(_currentIndent);
+	stream.lineState(SAFE_START);
+	if (stream.eof()) return; //nothing todo, or the rest is unchanged
 
 	switch (stream.peek())
 	{
@@ -137,7 +162,7 @@ void Haml::tag(StyleStream &stream)
 {
 	assert(stream.peek() == '%');
 	stream.advance(TAG);
-	advanceXmlName(stream, TAG);
+	html.name(stream, xmlNameLen(stream), Html::TAG, Html::TAGUNKNOWN);
 	tagStart(stream);
 }
 void Haml::tagId(StyleStream &stream)
@@ -173,8 +198,10 @@ void Haml::rubyAttrs(StyleStream &stream)
 {
 	assert(stream.peek() == '{');
 	stream.advance(Ruby::OPERATOR);
-	int depth = 1;
-	bool lineContinuation = false;
+	rubyAttrsBody(stream, 1, false);
+}
+void Haml::rubyAttrsBody(StyleStream &stream, int depth, bool lineContinuation)
+{
 	while (depth && !stream.eof())
 	{
 		char c = stream.peek();
@@ -184,7 +211,7 @@ void Haml::rubyAttrs(StyleStream &stream)
 		case '\n':
 			if (lineContinuation)
 			{
-				stream.advanceLine(DEFAULT);
+				stream.advanceLine(DEFAULT, DEFAULT, attrsState(RUBY_ATTRS, depth));
 				break;
 			}
 			else
@@ -262,7 +289,10 @@ void Haml::htmlAttrs(StyleStream &stream)
 {
 	assert(stream.peek() == '(');
 	stream.advance(Ruby::OPERATOR);
-	int depth = 1;
+	htmlAttrsBody(stream, 1);
+}
+void Haml::htmlAttrsBody(StyleStream &stream, int depth)
+{
 	while (depth && !stream.eof())
 	{
 		char c = stream.peek();
@@ -270,7 +300,7 @@ void Haml::htmlAttrs(StyleStream &stream)
 		{
 		case '\r':
 		case '\n':
-			stream.advanceLine(DEFAULT);
+			stream.advanceLine(DEFAULT, DEFAULT, attrsState(HTML_ATTRS, depth));
 			break;
 		case ')':
 			stream.advance(Ruby::OPERATOR);
@@ -27,7 +27,18 @@ class Haml : public BaseLexer
 {
 public:
 	virtual void style(StyleStream &stream)override;
+	virtual const char * SCI_METHOD DescribeWordListSets()override
+	{
+		return "HTML tag and attribute names\nRuby keywords\nRuby built-in names";
+	}
+	virtual void setWordList(int n, const std::shared_ptr<const WordList> &list)override;
 private:
+	enum WordLists
+	{
+		HTML_NAMES = 0,
+		RUBY_KEYWORDS = 1,
+		RUBY_BUILTINS = 2
+	};
 	enum Style
 	{
 		DEFAULT = 0,
@@ -42,10 +53,30 @@ private:
 		UNKNOWNFILTER = 9,
 		DOCTYPE = 60
 	};
+	/**Packed line state.
+	 * bit 0: SAFE_START
+	 * bits 1-2: LineContext
+	 * bits 3-10: bracket depth
+	 * bits 11-30: _currentIndent
+	 */
+	enum LineContext
+	{
+		/**Start of a line().*/
+		LINE_START = 0,
+		/**Inside multi-line {} attributes.*/
+		RUBY_ATTRS = 1,
+		/**Inside multi-line () attributes.*/
+		HTML_ATTRS = 2
+	};
 	unsigned _currentIndent;
 	Ruby ruby;
 	Html html;
 
+	/**Line state for a new line inside brackets, or 0 if it can not be resumed.*/
+	unsigned attrsState(LineContext context, int depth)const;
+	/**Continues the attributes from an attrsState line state.*/
+	void resume(StyleStream &stream, unsigned state);
+
 	/**Parsers a new line / statement. This must be called on a starting line, not in the
 	 * middle of a multi-line structure as there is no way to determine the syntax from
 	 * such a position.
@@ -68,10 +99,14 @@ private:
 	void tagStart(StyleStream &stream);
 	/**{...} element attributes.*/
 	void rubyAttrs(StyleStream &stream);
+	/**Rest of {...} element attributes and the line, after the brackets were opened to depth.*/
+	void rubyAttrsBody(StyleStream &stream, int depth, bool lineContinuation);
 	/**[...] element object reference.*/
 	void objectRef(StyleStream &stream);
 	/**(...) element HTML attributes.*/
 	void htmlAttrs(StyleStream &stream);
+	/**Rest of (...) element attributes and the line, after the brackets were opened to depth.*/
+	void htmlAttrsBody(StyleStream &stream, int depth);
 
 	/**Filter block starting with ':'.*/
 	void filter(StyleStream &stream);
@@ -16,28 +16,40 @@
 
 #include "Html.h"
 #include <cassert>
+#include <cstring>
 #include <string>
 
-void advanceXmlName(StyleStream &stream, char style)
+namespace
 {
-	while (true)
+	/**Names that are not in the list as given but are still valid. HTML names ignore case, any tag
+	 * with a hyphen is a custom element, and data- and aria- start open ended attribute sets.
+	 */
+	bool knownName(const WordList &names, const StrView &name, bool tag)
 	{
-		auto c = stream.peek();
-		if (c < 0) return;
-		if (c < 128 && c != '-' && c != '_' && !isAlphaNumeric((char)c)) return;
-		stream.advance(style);
+		auto str = name.data();
+		auto len = name.size();
+		if (tag && memchr(str, '-', len)) return true;
+		if (!tag && len > 5 && (memcmp(str, "data-", 5) == 0 || memcmp(str, "aria-", 5) == 0)) return true;
+
+		char lower[64];
+		if (len > sizeof(lower)) return false;
+		bool hasUpper = false;
+		for (unsigned i = 0; i < len; ++i)
+		{
+			hasUpper |= charIs(str[i], CHAR_UPPER);
+			lower[i] = charIs(str[i], CHAR_UPPER) ? (char)(str[i] - 'A' + 'a') : str[i];
+		}
+		return hasUpper && names.contains(lower, len);
 	}
 }
+
+void advanceXmlName(StyleStream &stream, char style)
+{
+	stream.advanceMatches(CHAR_XML_NAME, style);
+}
 unsigned xmlNameLen(StyleStream &stream)
 {
-	unsigned n = 0;
-	while (true)
-	{
-		auto c = stream.peek(n);
-		if (c < 0) return n;
-		if (c < 128 && c != '-' && c != '_' && !isAlphaNumeric((char)c)) return n;
-		++n;
-	}
+	return stream.countMatches(CHAR_XML_NAME);
 }
 
 void Html::line(StyleStream &stream)
@@ -56,9 +68,12 @@ void Html::line(StyleStream &stream)
 			entity(stream);
 			break;
 		default:
-			stream.advance(DEFAULT);
+		{
+			static const ByteSet TEXT_END("\r\n<&");
+			stream.advance(DEFAULT, stream.findAny(TEXT_END, 1));
 			break;
 		}
+		}
 	}
 }
 
@@ -89,6 +104,7 @@ void Html::tag(StyleStream &stream)
 	{
 		//close tag
 		stream.advance(TAG);
+		name(stream, xmlNameLen(stream), TAG, TAGUNKNOWN);
 
 		while (!stream.eof())
 		{
@@ -104,15 +120,10 @@ void Html::tag(StyleStream &stream)
 		}
 	}
 	//open tag
-	while (!stream.eof())
-	{
-		auto c = stream.peek();
-		if (c == '\n' || c == '\r')
-			return;
-		else if (c == ' ' || c == '/' || c == '>')
-			break;
-		else stream.advance(TAG);
-	}
+	unsigned len = 0;
+	for (auto c = stream.peek(); c >= 0 && c != '\n' && c != '\r' && c != ' ' && c != '/' && c != '>'; c = stream.peek(++len));
+	name(stream, len, TAG, TAGUNKNOWN);
+	if (stream.peek() == '\n' || stream.peek() == '\r') return;
 	while (!stream.eof())
 	{
 		auto c = stream.peek();
@@ -132,9 +143,9 @@ void Html::tag(StyleStream &stream)
 		}
 		else if (c == ' ' || c == '\t')
 		{
-			stream.advance(DEFAULT);
+			stream.advanceMatches(CHAR_SPACE, DEFAULT);
 		}
-		else if (c == '-' || c == '_' || isAlphaNumeric(c))
+		else if (charIs(c, CHAR_CSS_NAME))
 		{
 			attribute(stream);
 		}
@@ -146,7 +157,7 @@ void Html::tag(StyleStream &stream)
 }
 void Html::attribute(StyleStream &stream)
 {
-	advanceXmlName(stream, ATTRIBUTE);
+	name(stream, xmlNameLen(stream), ATTRIBUTE, ATTRIBUTEUNKNOWN);
 	if (stream.eof() || stream.peek() != '=') return;
 	stream.advance(ATTRIBUTEEQ);
 
@@ -158,7 +169,7 @@ void Html::attribute(StyleStream &stream)
 			stream.advance(ATTRIBUTEVALUE);
 			break;
 		}
-		else if (c == '-' || c == '_' || isAlphaNumeric(c))
+		else if (charIs(c, CHAR_CSS_NAME))
 		{
 			stream.advance(ATTRIBUTE);
 		}
@@ -175,3 +186,13 @@ void Html::attribute(StyleStream &stream)
 	}
 }
 
+void Html::name(StyleStream &stream, unsigned len, Style style, Style unknownStyle)
+{
+	auto &names = wordList(NAMES);
+	if (!names.empty())
+	{
+		auto str = stream.peekStr(len);
+		if (!names.contains(str) && !knownName(names, str, style == TAG)) style = unknownStyle;
+	}
+	stream.advance(style, len);
+}
@@ -39,10 +39,24 @@ public:
 		ATTRIBUTE = 63,
 		ATTRIBUTEVALUE = 64,
 		ATTRIBUTEEQ = 64,
-		ENTITY = 66
+		ENTITY = 66,
+		TAGUNKNOWN = 67,
+		ATTRIBUTEUNKNOWN = 68
+	};
+	/**Word lists.*/
+	enum WordLists
+	{
+		/**Known tag and attribute names. If set, other names get TAGUNKNOWN or ATTRIBUTEUNKNOWN,
+		 * except custom elements, data- and aria- attributes and names differing only by case.
+		 */
+		NAMES = 0
 	};
 
 	virtual void style(StyleStream &stream)override {}
+	virtual const char * SCI_METHOD DescribeWordListSets()override
+	{
+		return "HTML tag and attribute names";
+	}
 
 	void line(StyleStream &stream);
 
@@ -50,4 +64,6 @@ public:
 
 	void tag(StyleStream &stream);
 	void attribute(StyleStream &stream);
+	/**A tag or attribute name of len elements, with unknownStyle if it is not in NAMES.*/
+	void name(StyleStream &stream, unsigned len, Style style, Style unknownStyle);
 };
@@ -29,7 +29,17 @@
 
 void Markdown::style(StyleStream &stream)
 {
-	while (!stream.eof()) block(stream);
+	auto state = stream.lineState();
+	if (state & FENCED_CODE_STATE)
+	{
+		fencedCodeBody(stream, (char)(state >> 8), state >> 16);
+	}
+	while (!stream.eof())
+	{
+		//blank lines may yet be part of an indented code block
+		if (!stream.isBlankLine()) stream.lineState(SAFE_START);
+		if (!stream.eof()) block(stream);
+	}
 }
 
 void Markdown::block(StyleStream &stream)
@@ -125,11 +135,15 @@ bool Markdown::fencedCode(StyleStream &stream)
 	if (cnt < 3) return false;
 	if (stream.lineContains(spaces + cnt + 1, '`')) return false;
 
-	while (true)
+	stream.advanceLine(CODE, CODE, fencedCodeState(fenceChr, cnt));
+	fencedCodeBody(stream, fenceChr, cnt);
+	return true;
+}
+void Markdown::fencedCodeBody(StyleStream &stream, char fenceChr, unsigned cnt)
+{
+	while (stream.peek() >= 0)
 	{
-		stream.advanceLine(CODE, CODE);
-		if (stream.peek() < 0) break;
-		spaces = stream.countSp();
+		unsigned spaces = stream.countSp();
 		if (spaces <= 3)
 		{
 			unsigned cnt2 = stream.countChr(fenceChr, spaces);
@@ -142,8 +156,8 @@ bool Markdown::fencedCode(StyleStream &stream)
 				}
 			}
 		}
+		stream.advanceLine(CODE, CODE, fencedCodeState(fenceChr, cnt));
 	}
-	return true;
 }
 
 bool Markdown::indentedCode(StyleStream &stream)
@@ -176,14 +190,10 @@ bool Markdown::list(StyleStream &stream)
 	if (spaces > 3) return false;
 	unsigned w = 0;
 	auto c = stream.peek(spaces);
-	if (c >= '0' && c <= '9') //ordered
+	if (charIs(c, CHAR_DIGIT)) //ordered
 	{
-		do
-		{
-			++w;
-			c = stream.peek(spaces + w);
-		}
-		while (c >= '0' && c <= '9');
+		w = stream.countMatches(CHAR_DIGIT, spaces);
+		c = stream.peek(spaces + w);
 		if (c != '.' && c != ')') return false;
 		++w;
 	}
@@ -272,12 +282,13 @@ void Markdown::paragraph(StyleStream &stream)
 		{
 			inlineStream.addSection(stream, len - 2);
 			stream.advance(HARDBREAK, 2);
+			stream.advanceLine(DEFAULT);
 		}
 		else
 		{
-			inlineStream.addSection(stream, len);
+			//Including the line end lets the lines of a paragraph share one section
+			inlineStream.addSection(stream, len + stream.eolLen(len));
 		}
-		stream.advanceLine(DEFAULT);
 
 		auto c = stream.peek();
 		if (c < 0 || c == '\r' || c == '\n') break;
@@ -292,6 +303,8 @@ void Markdown::styleInline(StyleStream &stream, Style defaultStyle, char delimit
 	//TODO: This is not a complete parsing. Markdown only applies if the closing delimiter is present,
 	//else leaves the literal character. Also *, _ depend on those closing delimiters, e.g:
 	//"***bold-italic**italic*" "***bold-italic*bold***" "***bold asterisk**"
+	ByteSet special("*_`<[!~&\r\n");
+	if (delimiter) special.add(delimiter);
 	while (true)
 	{
 		if (delimiter && stream.matches(delimiter, n))
@@ -353,12 +366,13 @@ void Markdown::styleInline(StyleStream &stream, Style defaultStyle, char delimit
 			break;
 		case '\r':
 		case '\n':
-			stream.advance(DEFAULT);
+			stream.advanceEol(DEFAULT);
 			break;
 		case EOF:
 			return;
 		default:
-			stream.advance(defaultStyle);
+			//Plain text up to the next character that may start or end some markup
+			stream.advance(defaultStyle, stream.findAny(special, 1));
 			break;
 		}
 	}
@@ -381,7 +395,7 @@ void Markdown::inlineCode(StyleStream &stream)
 		{
 		case '\r':
 		case '\n':
-			stream.advance(DEFAULT);
+			stream.advanceEol(DEFAULT);
 			break;
 		case EOF:
 			return;
@@ -401,9 +415,12 @@ void Markdown::link(StyleStream &stream, Style style)
 		switch (stream.peek())
 		{
 		case EOF:
+			return;
 		case '\r':
 		case '\n':
-			return;
+			//Link text may continue on the next line of a paragraph
+			stream.advanceEol(DEFAULT);
+			break;
 		case ']':
 		{
 			stream.advance(style);
@@ -414,9 +431,11 @@ void Markdown::link(StyleStream &stream, Style style)
 				switch (stream.peek())
 				{
 				case EOF:
+					return;
 				case '\r':
 				case '\n':
-					return;
+					stream.advanceEol(DEFAULT);
+					break;
 				case ')':
 					stream.advance(style);
 					return;
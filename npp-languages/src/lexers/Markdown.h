@@ -25,7 +25,8 @@
 /**Lexer for Markdown.
  * Based loosley on http://spec.commonmark.org/0.26/
  *
- * Does not include HTML blocks
+ * Does not include HTML blocks. Has no word lists, as its markup is punctuation rather than
+ * names.
  */
 class Markdown : public BaseLexer
 {
@@ -65,6 +66,8 @@ public:
 	bool indentedCode(StyleStream &stream);
 	/**http://spec.commonmark.org/0.26/#fenced-code-blocks*/
 	bool fencedCode(StyleStream &stream);
+	/**Fenced code lines after the opening fence line, up to and including the closing fence.*/
+	void fencedCodeBody(StyleStream &stream, char fenceChr, unsigned cnt);
 	/**http://spec.commonmark.org/0.26/#link-reference-definitions*/
 	bool linkRefBlock(StyleStream &stream);
 	/**http://spec.commonmark.org/0.26/#block-quotes*/
@@ -80,4 +83,19 @@ public:
 	void inlineCode(StyleStream &stream);
 	/**http://spec.commonmark.org/0.26/#links*/
 	void link(StyleStream &stream, Style style);
+private:
+	/**Packed line state.
+	 * bit 0: SAFE_START
+	 * bit 1: inside fenced code
+	 * bits 8-15: fence character
+	 * bits 16-30: fence length
+	 */
+	static const unsigned FENCED_CODE_STATE = 2;
+
+	/**Line state for a new line inside fenced code, or 0 if it can not be resumed.*/
+	static unsigned fencedCodeState(char fenceChr, unsigned cnt)
+	{
+		if (cnt > 0x7FFF) return 0;
+		return SAFE_START | FENCED_CODE_STATE | ((unsigned)(unsigned char)fenceChr << 8) | (cnt << 16);
+	}
 };
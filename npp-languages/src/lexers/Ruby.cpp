@@ -15,33 +15,34 @@
 // along with this program.If not, see <http://www.gnu.org/licenses/>.
 
 #include "Ruby.h"
+#include "Keywords.h"
 #include <cassert>
-#include <string>
-#include <unordered_set>
+#include <cstring>
 
 namespace
 {
-	static const std::unordered_set<std::string> INSTRUCTIONS = {
-		//http://ruby-doc.org/docs/keywords/1.9/
-		"BEGIN", "END", "__ENCODING__", "__FILE__", "__LINE__",
-		"alias", "and", "begin", "break", "case", "class",
-		"def", "defined?", "do", "else", "elsif", "end", "ensure",
-		"false", "for", "if", "in", "module", "next", "nil", "not", "or",
-		"redo", "rescue", "retry", "return", "self", "super", "then", "true",
-		"undef", "unless", "until", "when", "while", "yield"
+	//http://ruby-doc.org/docs/keywords/1.9/
+	const Keyword INSTRUCTIONS[] = {
+		KEYWORD("do"), KEYWORD("if"), KEYWORD("in"), KEYWORD("or"),
+		KEYWORD("END"), KEYWORD("and"), KEYWORD("def"), KEYWORD("end"), KEYWORD("for"),
+		KEYWORD("nil"), KEYWORD("not"),
+		KEYWORD("case"), KEYWORD("else"), KEYWORD("next"), KEYWORD("redo"), KEYWORD("self"),
+		KEYWORD("then"), KEYWORD("true"), KEYWORD("when"),
+		KEYWORD("BEGIN"), KEYWORD("alias"), KEYWORD("begin"), KEYWORD("break"), KEYWORD("class"),
+		KEYWORD("elsif"), KEYWORD("false"), KEYWORD("retry"), KEYWORD("super"), KEYWORD("undef"),
+		KEYWORD("until"), KEYWORD("while"), KEYWORD("yield"),
+		KEYWORD("ensure"), KEYWORD("module"), KEYWORD("rescue"), KEYWORD("return"), KEYWORD("unless"),
+		KEYWORD("__FILE__"), KEYWORD("__LINE__"), KEYWORD("defined?"),
+		KEYWORD("__ENCODING__")
 	};
-	static const std::unordered_set<std::string> COND_INSTRUCTIONS = {
-		"for", "while", "until", "case", "if", "unless"
+	const Keyword COND_INSTRUCTIONS[] = {
+		KEYWORD("if"), KEYWORD("for"), KEYWORD("case"), KEYWORD("until"), KEYWORD("while"),
+		KEYWORD("unless")
 	};
 
-	bool nameChr(int c)
-	{
-		if (c < 0) return false;
-		return c == '_' || isAlphaNumeric((char)c);
-	}
 	bool methodEndChr(int c)
 	{
-		return nameChr(c) || c == '?' || c == '!';
+		return charIs(c, CHAR_WORD) || c == '?' || c == '!';
 	}
 	bool methodDefEndChr(int c)
 	{
@@ -49,23 +50,72 @@ namespace
 	}
 	unsigned nameLen(StyleStream &stream)
 	{
-		unsigned n = 0;
-		while (nameChr(stream.peek(n))) ++n;
-		return n;
+		return stream.countMatches(CHAR_WORD);
+	}
+
+	/**How Ruby::nextToken styles a token, by its first byte.*/
+	enum TokenKind
+	{
+		/**A name, keyword or other character.*/
+		TOKEN_WORD,
+		TOKEN_SPACE,
+		TOKEN_NUMBER,
+		/**Operator characters, styled as one run.*/
+		TOKEN_OPERATOR,
+		/**Brackets and ',', styled one at a time, as the code embedding Ruby counts them.*/
+		TOKEN_BRACKET,
+		TOKEN_GLOBAL,
+		TOKEN_COLON,
+		TOKEN_PERCENT,
+		TOKEN_AT,
+		TOKEN_SLASH,
+		TOKEN_BACKTICKS,
+		TOKEN_DOUBLE_QUOTE,
+		TOKEN_SINGLE_QUOTE
+	};
+	constexpr bool isOperator(unsigned c)
+	{
+		return c == '.' || c == '?' || c == '=' || c == '<' || c == '>' || c == '&' || c == '|' ||
+			c == '^' || c == '~' || c == '*' || c == '+' || c == '-';
 	}
+	constexpr unsigned char tokenKind(unsigned c)
+	{
+		return (unsigned char)(
+			c == ' ' || c == '\t' ? TOKEN_SPACE :
+			c >= '0' && c <= '9' ? TOKEN_NUMBER :
+			isOperator(c) ? TOKEN_OPERATOR :
+			c == ',' || c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}' ? TOKEN_BRACKET :
+			c == '$' ? TOKEN_GLOBAL :
+			c == ':' ? TOKEN_COLON :
+			c == '%' ? TOKEN_PERCENT :
+			c == '@' ? TOKEN_AT :
+			c == '/' ? TOKEN_SLASH :
+			c == '`' ? TOKEN_BACKTICKS :
+			c == '"' ? TOKEN_DOUBLE_QUOTE :
+			c == '\'' ? TOKEN_SINGLE_QUOTE :
+			TOKEN_WORD);
+	}
+	const unsigned char TOKEN_KINDS[256] = BYTE_TABLE(tokenKind);
 }
+const unsigned Ruby::INTERP_FRAME;
+
 void Ruby::style(StyleStream &stream)
 {
+	_resumable = true;
+	_frames.clear();
+	auto state = stream.lineState();
+	if (state & ~SAFE_START) resume(stream, state);
 	while (!stream.eof())
 	{
+		stream.lineState(SAFE_START);
 		styleLine(stream);
 	}
+	_resumable = false;
 }
 
 /**Style a upto the end of the line. Used by HAML etc.*/
-void Ruby::styleLine(StyleStream &stream)
+void Ruby::styleLine(StyleStream &stream, bool first)
 {
-	bool first = true;
 	while (true)
 	{
 		stream.advanceSpTab();
@@ -95,70 +145,119 @@ void Ruby::styleLine(StyleStream &stream)
 	}
 }
 
-void Ruby::string(StyleStream &stream)
+void Ruby::pushString(char delimL, char delimR, Style style, bool interpolated, int depth)
 {
-	switch (stream.peek())
+	Mode mode = {ByteSet("\\\r\n"), style, delimL, delimR, interpolated, depth};
+	mode.stops.add(delimL);
+	mode.stops.add(delimR);
+	if (interpolated) mode.stops.add('#');
+	_modes.push_back(mode);
+}
+void Ruby::pushInterp()
+{
+	Mode mode = {ByteSet(""), OPERATOR, 0, 0, false, 0};
+	_modes.push_back(mode);
+}
+void Ruby::run(StyleStream &stream, size_t base)
+{
+	while (_modes.size() > base)
 	{
-	case '"':
-		stream.advance(STRING);
-		return stringBody(stream, '"', '"', STRING, true);
-	case '\'':
-		stream.advance(CHARACTER);
-		return stringBody(stream, '\'', '\'', CHARACTER, false);
-	case '/':
-		stream.advance(REGEX);
-		return stringBody(stream, '/', '/', REGEX, true);
-	default:
-		assert(false);
-		stream.advance(ERROR);
-		return;
+		if (_modes.back().depth) stringStep(stream);
+		else interpStep(stream);
 	}
 }
-void Ruby::stringBody(StyleStream &stream,
-	char delimL, char delimR,
-	Style style, bool interpolated)
+void Ruby::stringStep(StyleStream &stream)
 {
-	int depth = 1;
-	bool escape = false;
-	while (depth)
+	auto &mode = _modes.back();
+	stream.advance(mode.style, stream.findAny(mode.stops));
+	auto c = stream.peek();
+	if (c < 0) _modes.pop_back();
+	else if (c == (unsigned char)mode.delimR)
 	{
-		bool thisEscape = escape;
-		escape = false;
-		char c = stream.peek();
-		if (c < 0) break;
-		else if (!thisEscape && c == delimR)
-		{
-			stream.advance(style);
-			--depth;
-		}
-		else if (!thisEscape && c == delimL)
-		{
-			stream.advance(style);
-			++depth;
-		}
-		else if (!thisEscape && interpolated && c == '#' && stream.peek(1) == '{')
+		stream.advance(mode.style);
+		if (--mode.depth == 0)
 		{
-			stringInterp(stream);
+			bool regex = mode.style == REGEX;
+			_modes.pop_back();
+			if (regex) regexModifiers(stream);
 		}
-		else if (c == '\r' || c == '\n')
+	}
+	else if (c == (unsigned char)mode.delimL)
+	{
+		stream.advance(mode.style);
+		++mode.depth;
+	}
+	else if (c == '\\')
+	{
+		//The escaped character is plain text, unless it is a line end
+		auto c2 = stream.peek(1);
+		stream.advance(mode.style, c2 < 0 || c2 == '\r' || c2 == '\n' ? 1 : 2);
+	}
+	else if (c == '#')
+	{
+		if (stream.peek(1) != '{') stream.advance(mode.style);
+		else
 		{
-			stream.advanceEol();
+			stream.advance(OPERATOR, 2);
+			pushInterp();
 		}
-		else if (c == '\\')
+	}
+	else nestedEol(stream);
+}
+void Ruby::interpStep(StyleStream &stream)
+{
+	auto c = stream.peek();
+	if (c < 0) _modes.pop_back();
+	else if (c == '}')
+	{
+		stream.advance(OPERATOR);
+		_modes.pop_back();
+	}
+	else if (c == '\r' || c == '\n') nestedEol(stream);
+	else nextToken(stream);
+}
+unsigned Ruby::stringFrame(char delimL, char delimR, Style style, bool interpolated, int depth)
+{
+	if (depth > 0x3F) return 0;
+	return SAFE_START |
+		((unsigned)style << 1) |
+		((unsigned)(unsigned char)delimL << 8) |
+		((unsigned)(unsigned char)delimR << 16) |
+		(interpolated ? 1U << 24 : 0) |
+		((unsigned)depth << 25);
+}
+void Ruby::nestedEol(StyleStream &stream)
+{
+	if (!_resumable) return stream.advanceEol();
+	_frames.clear();
+	for (auto &mode : _modes)
+	{
+		auto frame = mode.depth ?
+			stringFrame(mode.delimL, mode.delimR, mode.style, mode.interpolated, mode.depth) : INTERP_FRAME;
+		if (frame == 0) return stream.advanceEol();
+		_frames.push_back(frame);
+	}
+	if (_frames.size() == 1 && _frames[0] != INTERP_FRAME) stream.advanceEol(0, _frames[0]);
+	else stream.advanceEol(0, SAFE_START | EXTENDED_STATE, _frames);
+}
+void Ruby::resume(StyleStream &stream, unsigned state)
+{
+	LineStateTable::Entry frames;
+	if (state & EXTENDED_STATE) frames = stream.extendedLineState();
+	else frames.assign(1, state);
+	for (auto frame : frames)
+	{
+		if (frame == INTERP_FRAME) pushInterp();
+		else
 		{
-			escape = !thisEscape;
-			stream.advance(style);
+			pushString((char)(frame >> 8), (char)(frame >> 16), (Style)((frame >> 1) & 0x7F),
+				(frame & (1U << 24)) != 0, (int)((frame >> 25) & 0x3F));
 		}
-		else stream.advance(style);
 	}
+	run(stream, 0);
+	styleLine(stream, false);
 }
 
-void Ruby::regex(StyleStream &stream)
-{
-	assert(stream.peek() == '/');
-	string(stream);
-	regexModifiers(stream);
-}
 void Ruby::regexModifiers(StyleStream &stream)
 {
 	while (true)
@@ -168,7 +267,7 @@ void Ruby::regexModifiers(StyleStream &stream)
 		{
 			stream.advance(REGEX);
 		}
-		else if (c >= 0 && isAlphaNumeric((char)c))
+		else if (charIs(c, CHAR_ALNUM))
 		{
 			stream.advance(ERROR);
 			break;
@@ -208,27 +307,13 @@ void Ruby::stringLine(StyleStream &stream)
 		}
 	}
 }
-
 void Ruby::stringInterp(StyleStream &stream)
 {
 	assert(stream.matches("#{"));
 	stream.advance(OPERATOR, 2);
-	while (!stream.eof())
-	{
-		char c = stream.peek();
-		switch (c)
-		{
-		case '}':
-			stream.advance(OPERATOR);
-			return;
-		case '\r':
-		case '\n':
-			stream.advanceEol();
-			break;
-		default:
-			token(stream);
-		}
-	}
+	auto base = _modes.size();
+	pushInterp();
+	run(stream, base);
 }
 
 void Ruby::statementStart(StyleStream &stream)
@@ -236,38 +321,53 @@ void Ruby::statementStart(StyleStream &stream)
 	char c = stream.peek();
 	assert(c != '\n' && c != '\r');
 
-	auto word = peekInstruction(stream);
-	if (COND_INSTRUCTIONS.count(word))
+	auto len = instructionLen(stream);
+	if (findKeyword(COND_INSTRUCTIONS, stream, len) >= 0)
 	{
 		stream.foldHeader(stream.foldLevel());
 		stream.increaseFoldNext();
-		stream.advance(INSTRUCTION, word.size());
+		stream.advance(INSTRUCTION, len);
 	}
 	else token(stream);
 }
-
 void Ruby::token(StyleStream &stream)
 {
-	char c = stream.peek();
-	assert(c != '\n' && c != '\r');
-	switch (c)
+	auto base = _modes.size();
+	nextToken(stream);
+	run(stream, base);
+}
+void Ruby::nextToken(StyleStream &stream)
+{
+	auto c = stream.peek();
+	assert(c >= 0 && c != '\n' && c != '\r');
+	switch (TOKEN_KINDS[c])
 	{
-	case '.': case ',': case '?':
-	case '=': case '<': case '>':
-	case '&': case '|': case '^': case '~':
-	case '*': case '+': case '-':
-	case '(': case ')': case '[': case ']': case '{': case '}':
+	case TOKEN_SPACE:
+		stream.advanceMatches(CHAR_SPACE, DEFAULT);
+		break;
+	case TOKEN_NUMBER:
+		stream.advanceMatches(CHAR_DIGIT, NUMBER);
+		break;
+	case TOKEN_OPERATOR:
+	{
+		unsigned n = 1;
+		while (stream.peek(n) >= 0 && TOKEN_KINDS[stream.peek(n)] == TOKEN_OPERATOR) ++n;
+		stream.advance(OPERATOR, n);
+		break;
+	}
+	case TOKEN_BRACKET:
 		stream.advance(OPERATOR);
 		break;
-	case '$':
+	case TOKEN_GLOBAL:
 	{
 		stream.advance(GLOBAL);
 		auto n = nameLen(stream);
-		if (n == 0) stream.advance(GLOBAL);
-		else stream.advance(GLOBAL, n);
+		auto c2 = stream.peek();
+		if (n > 0) stream.advance(GLOBAL, n);
+		else if (c2 >= 0 && c2 != '\r' && c2 != '\n') stream.advance(GLOBAL); //special globals like $!
 		break;
 	}
-	case ':':
+	case TOKEN_COLON:
 	{
 		auto c2 = stream.peek(1);
 		if (c2 == ':') stream.advance(OPERATOR, 2);
@@ -279,78 +379,10 @@ void Ruby::token(StyleStream &stream)
 		}
 		break;
 	}
-	case '%':
-	{
-		// Ruby parsing for '%' is complex
-		// https://en.wikibooks.org/wiki/Ruby_Programming/Syntax/Literals#The_.25_Notation
-		Style strStyle = STRING;
-		bool interpolated = true;
-		int c1 = stream.peek(1);
-		unsigned n = 2;// '%' + delimL
-
-		int delimL = c1;
-		// Look for modifier, else c1 maybe a delimiter, else just a '%' operator
-		switch (c1)
-		{
-		case 'r':
-			strStyle = REGEX;
-			interpolated = true;
-			delimL = stream.peek(2);
-			++n;
-			break;
-		case 'x':
-			strStyle = BACKTICKS;
-			interpolated = true;
-			delimL = stream.peek(2);
-			++n;
-			break;
-		case 'Q':
-		case 'I':
-		case 'W':
-			strStyle = STRING;
-			interpolated = true;
-			delimL = stream.peek(2);
-			++n;
-			break;
-		case 'q':
-		case 'i':
-		case 'w':
-		case 's':
-			strStyle = CHARACTER;
-			interpolated = false;
-			delimL = stream.peek(2);
-			++n;
-			break;
-		}
-
-		// If did not find an ASCII symbol, assume its a operator not a string
-		if (delimL < 0 || !(
-			(delimL >= '!' && delimL <= '/') ||
-			(delimL >= ':' && delimL <= '@') ||
-			(delimL >= '[' && delimL <= '`') ||
-			(delimL >= '{' && delimL <= '~')))
-		{
-			stream.advance(OPERATOR);
-			break;
-		}
-
-		// Bracket symbols use open/close
-		char delimR;
-		switch (delimL)
-		{
-		case '(': delimR = ')'; break;
-		case '[': delimR = ']'; break;
-		case '{': delimR = '}'; break;
-		case '<': delimR = '>'; break;
-		default: delimR = delimL; break;
-		}
-
-		stream.advance(strStyle, n);
-		stringBody(stream, (char)delimL, delimR, strStyle, interpolated);
-		if (strStyle == REGEX) regexModifiers(stream);
+	case TOKEN_PERCENT:
+		percent(stream);
 		break;
-	}
-	case '@':
+	case TOKEN_AT:
 		if (stream.peek(1) == '@')
 		{
 			stream.advance(CLASS_VAR, 2);
@@ -362,129 +394,191 @@ void Ruby::token(StyleStream &stream)
 			name(stream, INSTANCE_VAR);
 		}
 		break;
-	case '/':
+	case TOKEN_SLASH:
 	{
 		auto c2 = stream.peek(1);
-		if (c2 > 0 && c2 != ' ' && c2 != '\t' && c2 != '\r' && c2 != '\n') regex(stream);
+		if (c2 > 0 && c2 != ' ' && c2 != '\t' && c2 != '\r' && c2 != '\n')
+		{
+			stream.advance(REGEX);
+			pushString('/', '/', REGEX, true);
+		}
 		else stream.advance(OPERATOR);
 		break;
 	}
-	case '`':
+	case TOKEN_BACKTICKS:
 		stream.advance(BACKTICKS);
-		stringBody(stream, '`', '`', BACKTICKS, true);
+		pushString('`', '`', BACKTICKS, true);
+		break;
+	case TOKEN_DOUBLE_QUOTE:
+		stream.advance(STRING);
+		pushString('"', '"', STRING, true);
 		break;
-	case '\'': case '"':
-		string(stream);
+	case TOKEN_SINGLE_QUOTE:
+		stream.advance(CHARACTER);
+		pushString('\'', '\'', CHARACTER, false);
 		break;
 	default:
-		if (c >= '0' && c <= '9')
+	{
+		auto len = instructionLen(stream);
+		int keyword;
+		if (len == 0)
 		{
-			stream.advance(NUMBER);
+			stream.advance(0);
 		}
-		else
+		else if (stream.peek(len) == ':')
+		{
+			stream.advance(SYMBOL, len + 1);
+		}
+		else if ((keyword = findKeyword(INSTRUCTIONS, stream, len)) >= 0)
 		{
-			auto word = peekInstruction(stream);
-			if (word.empty())
+			const char *word = INSTRUCTIONS[keyword].word;
+			stream.advance(INSTRUCTION, len);
+			if (!strcmp(word, "class"))
 			{
-				stream.advance(0);
+				stream.advanceSpTab();
+				name(stream, CLASS_DEF);
+				stream.foldHeader(stream.foldLevel());
+				stream.increaseFoldNext();
 			}
-			else if (stream.peek((unsigned)word.size()) == ':')
+			else if (!strcmp(word, "def"))
 			{
-				stream.advance(SYMBOL, (unsigned)word.size() + 1);
+				stream.advanceSpTab();
+				name(stream, METHOD_DEF, true);
+				stream.foldHeader(stream.foldLevel());
+				stream.increaseFoldNext();
 			}
-			else if (INSTRUCTIONS.count(word))
+			else if (!strcmp(word, "module"))
 			{
-				stream.advance(INSTRUCTION, (unsigned)word.size());
-				if (word == "class")
-				{
-					stream.advanceSpTab();
-					name(stream, CLASS_DEF);
-					stream.foldHeader(stream.foldLevel());
-					stream.increaseFoldNext();
-				}
-				else if (word == "def")
-				{
-					stream.advanceSpTab();
-					name(stream, METHOD_DEF, true);
-					stream.foldHeader(stream.foldLevel());
-					stream.increaseFoldNext();
-				}
-				else if (word == "module")
-				{
-					stream.advanceSpTab();
-					name(stream, MODULE_DEF);
-					stream.foldHeader(stream.foldLevel());
-					stream.increaseFoldNext();
-				}
-				else if (word == "do")
-				{
-					stream.foldHeader(stream.foldLevel());
-					stream.increaseFoldNext();
-				}
-				else if (word == "end")
-				{
-					stream.reduceFoldNext();
-				}
+				stream.advanceSpTab();
+				name(stream, MODULE_DEF);
+				stream.foldHeader(stream.foldLevel());
+				stream.increaseFoldNext();
+			}
+			else if (!strcmp(word, "do"))
+			{
+				stream.foldHeader(stream.foldLevel());
+				stream.increaseFoldNext();
+			}
+			else if (!strcmp(word, "end"))
+			{
+				stream.reduceFoldNext();
 			}
-			else stream.advance(DEFAULT, (unsigned)word.size());
 		}
+		else stream.advance(wordStyle(stream, len), len);
 		break;
 	}
+	}
 }
-
-void Ruby::name(StyleStream &stream, Style style, bool method)
+void Ruby::percent(StyleStream &stream)
 {
-	int c;
-	while (true)
+	assert(stream.peek() == '%');
+	// Ruby parsing for '%' is complex
+	// https://en.wikibooks.org/wiki/Ruby_Programming/Syntax/Literals#The_.25_Notation
+	Style strStyle = STRING;
+	bool interpolated = true;
+	int c1 = stream.peek(1);
+	unsigned n = 2;// '%' + delimL
+
+	int delimL = c1;
+	// Look for modifier, else c1 maybe a delimiter, else just a '%' operator
+	switch (c1)
 	{
-		c = stream.peek();
-		if (c < 0) break;
-		else if (nameChr(c)) stream.advance(style);
-		else break;
+	case 'r':
+		strStyle = REGEX;
+		interpolated = true;
+		delimL = stream.peek(2);
+		++n;
+		break;
+	case 'x':
+		strStyle = BACKTICKS;
+		interpolated = true;
+		delimL = stream.peek(2);
+		++n;
+		break;
+	case 'Q':
+	case 'I':
+	case 'W':
+		strStyle = STRING;
+		interpolated = true;
+		delimL = stream.peek(2);
+		++n;
+		break;
+	case 'q':
+	case 'i':
+	case 'w':
+	case 's':
+		strStyle = CHARACTER;
+		interpolated = false;
+		delimL = stream.peek(2);
+		++n;
+		break;
+	}
+
+	// If did not find an ASCII symbol, assume its a operator not a string
+	if (delimL < 0 || !(
+		(delimL >= '!' && delimL <= '/') ||
+		(delimL >= ':' && delimL <= '@') ||
+		(delimL >= '[' && delimL <= '`') ||
+		(delimL >= '{' && delimL <= '~')))
+	{
+		stream.advance(OPERATOR);
+		return;
 	}
+
+	// Bracket symbols use open/close
+	char delimR;
+	switch (delimL)
+	{
+	case '(': delimR = ')'; break;
+	case '[': delimR = ']'; break;
+	case '{': delimR = '}'; break;
+	case '<': delimR = '>'; break;
+	default: delimR = delimL; break;
+	}
+
+	stream.advance(strStyle, n);
+	pushString((char)delimL, delimR, strStyle, interpolated);
+}
+
+Ruby::Style Ruby::wordStyle(StyleStream &stream, unsigned len)const
+{
+	auto &keywords = wordList(KEYWORDS), &builtins = wordList(BUILTINS);
+	if (keywords.empty() && builtins.empty()) return DEFAULT;
+	auto word = stream.peekStr(len);
+	if (keywords.contains(word)) return INSTRUCTION;
+	if (builtins.contains(word)) return BUILTIN;
+	return DEFAULT;
+}
+
+void Ruby::name(StyleStream &stream, Style style, bool method)
+{
+	stream.advanceMatches(CHAR_WORD, style);
+	auto c = stream.peek();
 	if (method && (c == '!' || c == '?')) stream.advance(style);
 	else if (style == METHOD_DEF && c == '=') stream.advance(METHOD_DEF);
 }
 
 unsigned Ruby::findNextInterp(StyleStream &stream)
 {
-	int i = 0;
-	bool escape = false;
+	static const ByteSet STOP("\r\n#");
+	unsigned i = 0;
 	while (true)
 	{
-		switch (stream.peek(i))
+		i = stream.findAny(STOP, i);
+		if (stream.peek(i) != '#') return i;
+		if (stream.peek(i + 1) == '{')
 		{
-		case EOF:
-		case '\r':
-		case '\n':
-			return i;
-		case '#':
-			if (!escape && stream.peek(i + 1) == '{')
-				return i;
-			escape = false;
-			break;
-		case '\\':
-			escape = !escape;
-			break;
-		default:
-			escape = false;
-			break;
+			//Escaped by an odd number of backslashes
+			unsigned slashes = 0;
+			while (slashes < i && stream.peek(i - slashes - 1) == '\\') ++slashes;
+			if (slashes % 2 == 0) return i;
 		}
 		++i;
 	}
 }
-std::string Ruby::peekInstruction(StyleStream &stream)
+unsigned Ruby::instructionLen(StyleStream &stream)
 {
-	std::string word;
-	while (true)
-	{
-		auto c2 = stream.peek((unsigned)word.size());
-		if (!nameChr(c2))
-		{
-			if (methodEndChr(c2)) word.push_back((char)c2);
-			break;
-		}
-		else word.push_back((char)c2);
-	}
-	return word;
+	unsigned len = nameLen(stream);
+	if (methodEndChr(stream.peek(len))) ++len;
+	return len;
 }
@@ -17,6 +17,7 @@
 #pragma once
 #include "BaseLexer.h"
 #include <memory>
+#include <vector>
 #ifdef ERROR
 #undef ERROR
 #endif
@@ -42,26 +43,39 @@ public:
 		MODULE_DEF = 92,
 		INSTANCE_VAR = 93,
 		CLASS_VAR = 94,
-		BACKTICKS = 95
+		BACKTICKS = 95,
+		BUILTIN = 98
 	};
+	/**Word lists.*/
+	enum WordLists
+	{
+		/**More words styled as INSTRUCTION.*/
+		KEYWORDS = 0,
+		/**Words styled as BUILTIN, such as core classes and methods.*/
+		BUILTINS = 1
+	};
+
+	Ruby() : _resumable(false), _modes(), _frames() {}
 
 	virtual void style(StyleStream &stream)override;
-	/**Style a upto the end of the line. Used by HAML etc.*/
-	void styleLine(StyleStream &stream);
-	/**A quoted string, regex, etc. string with escapes and interpolation.*/
-	void string(StyleStream &stream);
-	void stringBody(StyleStream &stream,
-		char delimL, char delimR,
-		Style style, bool interpolated);
-	void regex(StyleStream &stream);
+	virtual const char * SCI_METHOD DescribeWordListSets()override
+	{
+		return "Ruby keywords\nRuby built-in names";
+	}
+	/**Style a upto the end of the line. Used by HAML etc.
+	 * @param first True if at the start of a statement.
+	 */
+	void styleLine(StyleStream &stream, bool first = true);
 	void regexModifiers(StyleStream &stream);
 	/**Rest of the line as a string (no delimiter)*/
 	void stringLine(StyleStream &stream);
-	/**Interpolated string content.*/
+	/**Interpolated string content, up to and including the '}'.*/
 	void stringInterp(StyleStream &stream);
 	/**Statement start first token on a line, or after ';'.*/
 	void statementStart(StyleStream &stream);
-	/**Some token on the line.*/
+	/**Some token on the line. A string is styled up to its closing delimiter, which may be on
+	 * a later line.
+	 */
 	void token(StyleStream &stream);
 	/**Name string for variable, symbol, etc.*/
 	void name(StyleStream &stream, Style style, bool method=false);
@@ -70,6 +84,69 @@ public:
 	 * @return Offset of #{, end of line, or end of file.
 	 */
 	unsigned findNextInterp(StyleStream &stream);
-	/**Reads an upcoming instruction word.*/
-	std::string peekInstruction(StyleStream &stream);
+	/**Gets the length of an upcoming instruction word, including a trailing '?' or '!'.*/
+	unsigned instructionLen(StyleStream &stream);
+private:
+	/**_frames entry for an interpolation.*/
+	static const unsigned INTERP_FRAME = 2;
+
+	/**A string or #{} interpolation on the _modes stack.*/
+	struct Mode
+	{
+		/**Bytes that end a run of plain text in a string.*/
+		ByteSet stops;
+		Style style;
+		char delimL, delimR;
+		bool interpolated;
+		/**Open delimiters of a string, or 0 for an interpolation.*/
+		int depth;
+	};
+
+	/**True while styling with style(), where multi-line strings can be resumed from their line
+	 * state. False for Ruby embedded in another language.
+	 */
+	bool _resumable;
+	/**Strings and interpolations currently being styled, outermost first.*/
+	std::vector<Mode> _modes;
+	/**Line state frames for _modes at a line end. A string in a line state on its own, else
+	 * stored as an extended line state.
+	 */
+	LineStateTable::Entry _frames;
+
+	/**Packed line state for a line inside a multi-line string, or 0 if it can not be resumed.
+	 * bit 0: SAFE_START
+	 * bits 1-7: string style
+	 * bits 8-15: left delimiter
+	 * bits 16-23: right delimiter
+	 * bit 24: interpolated
+	 * bits 25-30: delimiter depth
+	 */
+	static unsigned stringFrame(char delimL, char delimR, Style style, bool interpolated, int depth);
+	/**Style EOL inside a string or interpolation, and set the line state from _modes.*/
+	void nestedEol(StyleStream &stream);
+	/**Continues the strings from a stringFrame or extended line state, then the rest of its line.*/
+	void resume(StyleStream &stream, unsigned state);
+
+	/**Opens a string after its opening delimiter, up to the closing delimiter that brings
+	 * depth to 0.
+	 */
+	void pushString(char delimL, char delimR, Style style, bool interpolated, int depth = 1);
+	/**Opens an interpolation after its '#{'.*/
+	void pushInterp();
+	/**Styles the strings and interpolations on _modes, innermost first, until only base are
+	 * left or the stream ends.
+	 */
+	void run(StyleStream &stream, size_t base);
+	/**Styles the innermost string up to and including the next delimiter, escape,
+	 * interpolation start or line end.
+	 */
+	void stringStep(StyleStream &stream);
+	/**Styles the next token of the innermost interpolation.*/
+	void interpStep(StyleStream &stream);
+	/**Styles one token. A string is opened on _modes for run, rather than styled here.*/
+	void nextToken(StyleStream &stream);
+	/**'%' literal or operator.*/
+	void percent(StyleStream &stream);
+	/**Style for a word of len that is not an instruction, from the KEYWORDS and BUILTINS lists.*/
+	Style wordStyle(StyleStream &stream, unsigned len)const;
 };
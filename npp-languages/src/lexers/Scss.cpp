@@ -16,39 +16,44 @@
 
 #include "Scss.h"
 #include <cassert>
-#include <string>
 
 namespace
 {
-	bool keywordChr(int c)
+	StrView keyword(StyleStream &stream)
 	{
-		return c >= 'a' && c <= 'z';
+		return stream.peekStr(CHAR_LOWER);
 	}
-	bool hexChr(int c)
-	{
-		return (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || (c >= '0' && c <= '9');
-	}
-	std::string keyword( StyleStream &stream)
+	bool cssNameChr(int c)
 	{
-		return stream.peekStr(&keywordChr);
+		return charIs(c, CHAR_CSS_NAME);
 	}
-	bool cssNameChr(int c)
+}
+
+void Scss::style(StyleStream &stream)
+{
+	_blockDepth = 0;
+	auto state = stream.lineState();
+	if (state & ~SAFE_START) resume(stream, state);
+	while (!stream.eof())
 	{
-		return isAlphaNumeric(c) || c == '_' || c == '-';
+		stream.lineState(SAFE_START);
+		globalLine(stream);
 	}
-	bool xmlNameChr(int c)
+}
+void Scss::resume(StyleStream &stream, unsigned state)
+{
+	if (state & COMMENT_STATE)
 	{
-		return cssNameChr(c);
+		_blockDepth = state >> BLOCK_DEPTH_SHIFT;
+		cssCommentBody(stream);
 	}
-	bool lengthChr(int c)
+	//Each block returns to the loop of the block containing it
+	for (unsigned depth = state >> BLOCK_DEPTH_SHIFT; depth > 0 && !stream.eof(); --depth)
 	{
-		return c >= 'a' && c <= 'z';
+		_blockDepth = depth - 1;
+		declarationBlockBody(stream);
 	}
-}
-
-void Scss::style(StyleStream &stream)
-{
-	while (!stream.eof()) globalLine(stream);
+	globalLine(stream);
 }
 
 void Scss::globalLine(StyleStream &stream)
@@ -161,11 +166,15 @@ void Scss::cssComment(StyleStream &stream)
 	stream.foldHeader(stream.foldLevel());
 	stream.increaseFoldNext();
 	stream.advance(CSS_COMMENT, 2);
+	cssCommentBody(stream);
+}
+void Scss::cssCommentBody(StyleStream &stream)
+{
 	while (true)
 	{
 		auto c = stream.peek();
 		if (c < 0) return;
-		else if (c == '\r' || c == '\n') stream.advanceEol();
+		else if (c == '\r' || c == '\n') stream.advanceEol(0, blockState(true));
 		else if (c == '*' && stream.peek(1) == '/')
 		{
 			stream.reduceFoldNext();
@@ -180,7 +189,7 @@ void Scss::variableDef(StyleStream &stream)
 	assert(stream.peek('$'));
 	stream.advance(VARIABLE);
 	if (!cssNameChr(stream.peek())) return errorStatement(stream);
-	stream.advanceMatches(cssNameChr, VARIABLE);
+	stream.advanceMatches(CHAR_CSS_NAME, VARIABLE);
 
 	stream.advanceSpTab();
 	if (stream.peek() != ':') return errorStatement(stream);
@@ -221,41 +230,41 @@ void Scss::value(StyleStream &stream)
 	else if (c == '$')
 	{
 		stream.advance(VARIABLE);
-		stream.advanceMatches(cssNameChr, VARIABLE);
+		stream.advanceMatches(CHAR_CSS_NAME, VARIABLE);
 	}
 	else if (c == '#') hexColor(stream);
 	else if (c >= '0' && c < '9') number(stream);
 	else if (c == '\'' || c == '"') string(stream);
-	else stream.advance(CSS_COMMENT);
+	else
+	{
+		//A whole name, so a colour is not found in the middle of another word
+		unsigned n = stream.countMatches(CHAR_CSS_NAME);
+		if (n == 0) n = 1;
+		auto &colors = wordList(COLORS);
+		if (!colors.empty() && colors.contains(stream.peekStr(n))) stream.advance(COLOR, n);
+		else stream.advance(CSS_COMMENT, n);
+	}
 }
 void Scss::number(StyleStream &stream)
 {
 	auto c = stream.peek();
 	assert(c >= '0' && c <= '9');
-	while (true)
-	{
-		c = stream.peek();
-		if (c >= '0' && c <= '9') stream.advance(NUMBER);
-		else break;
-	}
+	stream.advanceMatches(CHAR_DIGIT, NUMBER);
+	c = stream.peek();
 	if (c == '.')
 	{
 		stream.advance(NUMBER);
-		while (true)
-		{
-			c = stream.peek();
-			if (c >= '0' && c <= '9') stream.advance(NUMBER);
-			else break;
-		}
+		stream.advanceMatches(CHAR_DIGIT, NUMBER);
+		c = stream.peek();
 	}
 	if (c == '%') stream.advance(NUMBER);
-	else stream.advanceMatches(keywordChr, NUMBER);
+	else stream.advanceMatches(CHAR_LOWER, NUMBER);
 }
 void Scss::hexColor(StyleStream &stream)
 {
 	assert(stream.peek() == '#');
 	stream.advance(COLOR);
-	auto n = stream.countMatches(hexChr);
+	auto n = stream.countMatches(CHAR_HEX);
 	if (n == 3 || n == 6) stream.advance(COLOR, n);
 	else stream.advance(ERROR, n);
 }
@@ -357,30 +366,29 @@ bool Scss::selectorElement(StyleStream &stream)
 	else if (c == '.')
 	{
 		stream.advance(CLASS);
-		stream.advanceMatches(cssNameChr, CLASS);
+		stream.advanceMatches(CHAR_CSS_NAME, CLASS);
 	}
 	else if (c == '#')
 	{
 		stream.advance(ID);
-		stream.advanceMatches(cssNameChr, ID);
+		stream.advanceMatches(CHAR_CSS_NAME, ID);
 	}
 	else if (c == ':')
 	{
 		if (stream.peek(1) == ':')
 		{
 			stream.advance(PSEUDO, 2);
-			stream.advanceMatches(cssNameChr, PSEUDO);
+			stream.advanceMatches(CHAR_CSS_NAME, PSEUDO);
 		}
 		else
 		{
 			stream.advance(PSEUDO, 1);
-			stream.advanceMatches(cssNameChr, PSEUDO);
+			stream.advanceMatches(CHAR_CSS_NAME, PSEUDO);
 		}
 	}
 	else
 	{
-		auto str = stream.peekStr(cssNameChr);
-		if (str.size()) stream.advance(TAG);
+		if (cssNameChr(stream.peek())) stream.advance(TAG);
 		else return false;
 	}
 	return true;
@@ -392,11 +400,16 @@ void Scss::declarationBlock(StyleStream &stream)
 	stream.advance(OPERATOR);
 	stream.foldHeader(stream.foldLevel());
 	stream.increaseFoldNext();
+	declarationBlockBody(stream);
+}
+void Scss::declarationBlockBody(StyleStream &stream)
+{
+	++_blockDepth;
 	while (true)
 	{
 		stream.advanceSpTab();
 		auto c = stream.peek();
-		auto n = stream.countMatches(cssNameChr);
+		auto n = stream.countMatches(CHAR_CSS_NAME);
 		if (n > 0 && stream.peekAfterSpTab(n) == ':')
 		{
 			stream.advance(DEFAULT, n);
@@ -409,12 +422,13 @@ void Scss::declarationBlock(StyleStream &stream)
 		{
 			stream.advance(OPERATOR);
 			stream.reduceFoldNext();
-			return;
+			break;
 		}
 		else if (c == ' ' || c == '\t') stream.advanceSpTab();
-		else if (c == '\r' || c == '\n') stream.advanceEol();
+		else if (c == '\r' || c == '\n') stream.advanceEol(0, blockState());
 		else if (!basicStatement(stream)) stream.advance(ERROR);
 	}
+	--_blockDepth;
 }
 
 void Scss::mediaQuery(StyleStream &stream)
@@ -446,7 +460,7 @@ void Scss::mixin(StyleStream &stream)
 	assert(stream.matches("@mixin"));
 	stream.advance(OPERATOR, sizeof("@mixin") - 1);
 	stream.advanceSpTab();
-	stream.advanceMatches(cssNameChr, OPERATOR);
+	stream.advanceMatches(CHAR_CSS_NAME, OPERATOR);
 	stream.advanceSpTab();
 
 	if (stream.peek() == '(')
@@ -24,8 +24,8 @@
 class Scss : public BaseLexer
 {
 public:
-	Scss() : _scss(true) {}
-	explicit Scss(bool scss) : _scss(scss) {}
+	Scss() : _scss(true), _blockDepth(0) {}
+	explicit Scss(bool scss) : _scss(scss), _blockDepth(0) {}
 	enum Style
 	{
 		DEFAULT = 0,
@@ -44,9 +44,20 @@ public:
 		COLOR,
 		PSEUDO
 	};
+	/**Word lists.*/
+	enum WordLists
+	{
+		/**Names styled as COLOR in values, such as red or transparent.*/
+		COLORS = 0
+	};
 
 	virtual void style(StyleStream &stream)override;
-
+	virtual const char * SCI_METHOD DescribeWordListSets()override
+	{
+		return "CSS colour names";
+	}
+	/**Plain CSS reads the fold level to tell a nested block, which is an error.*/
+	virtual bool readsFoldLevels()const override { return !_scss; }
 
 	void globalLine(StyleStream &stream);
 	void globalStatement(StyleStream &stream);
@@ -68,11 +79,34 @@ public:
 
 	/**Declaration block can contain any basicStatement, including nested selectors plus CSS styles.*/
 	void declarationBlock(StyleStream &stream);
+	/**Contents of a declaration block after the '{', up to and including the '}'.*/
+	void declarationBlockBody(StyleStream &stream);
 
 	void mediaQuery(StyleStream &stream);
 	void mixin(StyleStream &stream);
 	void import(StyleStream &stream);
 private:
+	/**Packed line state.
+	 * bit 0: SAFE_START
+	 * bit 1: inside a CSS comment
+	 * bits 2-30: declaration block depth
+	 */
+	static const unsigned COMMENT_STATE = 2;
+	static const unsigned BLOCK_DEPTH_SHIFT = 2;
+
 	/**True if SCSS, else CSS.*/
 	bool _scss;
+	/**Number of declarationBlockBody currently being styled.*/
+	unsigned _blockDepth;
+
+	/**Line state for a new line in the current block, or 0 if it can not be resumed.*/
+	unsigned blockState(bool comment = false)const
+	{
+		if (_blockDepth > (EXTENDED_STATE - 1) >> BLOCK_DEPTH_SHIFT) return 0;
+		return SAFE_START | (comment ? COMMENT_STATE : 0) | (_blockDepth << BLOCK_DEPTH_SHIFT);
+	}
+	/**Continues the comment or blocks from a blockState line state, then the rest of its line.*/
+	void resume(StyleStream &stream, unsigned state);
+	/**Rest of a comment after the opening slash-star.*/
+	void cssCommentBody(StyleStream &stream);
 };
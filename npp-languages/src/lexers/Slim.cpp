@@ -15,20 +15,26 @@
 // along with this program.If not, see <http://www.gnu.org/licenses/>.
 
 #include "Slim.h"
-#include <unordered_set>
+#include "Keywords.h"
+#include <cstring>
 
 namespace
 {
-	//TODO: Use Notepad++ keywords
-	std::unordered_set<std::string> ENGINES =
+	//Read only, as they are shared by lexers on the UI and background threads
+	//Other engines can be added with the FILTER_ENGINES word list
+	const Keyword ENGINES[] =
 	{
-		"ruby", "javascript", "css", "sass", "scss", "less", "styl", "coffee", "asciidoc",
-		"markdown", "textile", "creole", "wiki", "mediawiki", "rdoc", "nokogiri", "none"
+		KEYWORD("css"),
+		KEYWORD("ruby"), KEYWORD("sass"), KEYWORD("scss"), KEYWORD("less"), KEYWORD("styl"),
+		KEYWORD("wiki"), KEYWORD("rdoc"), KEYWORD("none"),
+		KEYWORD("coffee"), KEYWORD("creole"), KEYWORD("textile"),
+		KEYWORD("asciidoc"), KEYWORD("markdown"), KEYWORD("nokogiri"),
+		KEYWORD("mediawiki"), KEYWORD("javascript")
 	};
 	// Engines with interpolation done by Slim
-	std::unordered_set<std::string> INTERPOLATED_ENGINES =
+	const Keyword INTERPOLATED_ENGINES[] =
 	{
-		"css", "markdown"
+		KEYWORD("css"), KEYWORD("markdown")
 	};
 }
 
@@ -37,34 +43,23 @@ Slim::Slim()
 	, _currentIndent(0)
 {}
 
+void Slim::setWordList(int n, const std::shared_ptr<const WordList> &list)
+{
+	BaseLexer::setWordList(n, list);
+	if (n == HTML_NAMES) _html.setWordList(Html::NAMES, list);
+	else if (n == RUBY_KEYWORDS) _ruby.setWordList(Ruby::KEYWORDS, list);
+	else if (n == RUBY_BUILTINS) _ruby.setWordList(Ruby::BUILTINS, list);
+}
+
 void Slim::style(StyleStream &stream)
 {
 	_currentIndent = stream.advanceIndent();
 	while (!stream.eof()) line(stream);
 }
-void SCI_METHOD Slim::Lex(unsigned int startPos, int lengthDoc, int initStyle, IDocument *doc)
-{
-	//return BaseLexer::Lex(startPos, lengthDoc, initStyle, doc);
-	int startLine = doc->LineFromPosition(startPos);
-	if (startLine > 0) --startLine; //if the edited lines indent changed, then its meaning may depend on the previous item
-	while (startLine > 0 && doc->GetLineState(startLine) != SAFE_START) --startLine;
-	unsigned actualStartPos = (unsigned)doc->LineStart(startLine);
-	assert(actualStartPos <= startPos);
-
-	unsigned end = startPos + lengthDoc;
-	end = doc->LineStart(doc->LineFromPosition(startPos + lengthDoc) + 1);
-
-	char last[100];
-	doc->GetCharRange(last, end - 10, 100);
-
-	DocumentStyleStream stream(doc, startLine, end - actualStartPos);
-	style(stream);
-}
-
 void Slim::line(StyleStream &stream)
 {
-	stream.lineState(SAFE_START);
 	stream.foldIndent(_currentIndent);
+	stream.lineState(SAFE_START);
 	if (stream.eof()) return;
 	switch (stream.peek())
 	{
@@ -87,8 +82,9 @@ void Slim::line(StyleStream &stream)
 		auto n = xmlNameLen(stream);
 		if (stream.peek(n) == ':')
 		{
-			auto name = stream.peekStr(n);
-			if (ENGINES.count(name)) return filterBlock(stream, name);
+			auto engine = findKeyword(ENGINES, stream, n);
+			if (engine >= 0) return filterBlock(stream, ENGINES[engine]);
+			else if (wordList(FILTER_ENGINES).contains(stream.peekStr(n))) return filterBlock(stream, Keyword{"", n});
 			else return tagName(stream);
 		}
 		else if (stream.matches("include"))
@@ -104,8 +100,9 @@ void Slim::tagOrFilter(StyleStream &stream)
 	auto n = xmlNameLen(stream);
 	if (stream.peek(n) == ':')
 	{
-		auto name = stream.peekStr(n);
-		if (ENGINES.count(name)) return filterBlock(stream, name);
+		auto engine = findKeyword(ENGINES, stream, n);
+		if (engine >= 0) return filterBlock(stream, ENGINES[engine]);
+		else if (wordList(FILTER_ENGINES).contains(stream.peekStr(n))) return filterBlock(stream, Keyword{"", n});
 		else return tagName(stream);
 	}
 	else return tagName(stream);
@@ -175,7 +172,7 @@ void Slim::tagStart(StyleStream &stream)
 }
 void Slim::tagName(StyleStream &stream)
 {
-	advanceXmlName(stream, TAG);
+	_html.name(stream, xmlNameLen(stream), Html::TAG, Html::TAGUNKNOWN);
 	tagStart(stream);
 }
 void Slim::tagId(StyleStream &stream)
@@ -212,7 +209,7 @@ void Slim::tagAttrs(StyleStream &stream)
 			auto n = xmlNameLen(stream);
 			if (stream.peek(n) == '=')
 			{
-				stream.advance(HTMLATTRIBUTE, n);
+				_html.name(stream, n, Html::ATTRIBUTE, Html::ATTRIBUTEUNKNOWN);
 				stream.advance(OPERATOR);
 				if (stream.peek() == '=') stream.advance(OPERATOR);
 				attrValue(stream);
@@ -260,7 +257,7 @@ void Slim::tagWrappedAttrs(StyleStream &stream)
 			if (n == 0) stream.advance(ERROR);
 			else
 			{
-				stream.advance(HTMLATTRIBUTE, n);
+				_html.name(stream, n, Html::ATTRIBUTE, Html::ATTRIBUTEUNKNOWN);
 				stream.advanceSpTab();
 				if (stream.peek() != '=') continue;
 				else
@@ -389,14 +386,14 @@ void Slim::rubyBlock(StyleStream &stream)
 	}
 }
 
-void Slim::filterBlock(StyleStream &stream, const std::string &engine)
+void Slim::filterBlock(StyleStream &stream, const Keyword &engine)
 {
-	assert(stream.matches(engine.c_str()) && stream.peek((unsigned)engine.size()) == ':');
-	stream.advance(FILTER, engine.size() + 1);
+	assert(stream.matches(engine.word) && stream.peek(engine.len) == ':');
+	bool interpolate = findKeyword(INTERPOLATED_ENGINES, stream, engine.len) >= 0;
+	stream.advance(FILTER, engine.len + 1);
 	unsigned indent = _currentIndent;
 	StyleStream blockStream(stream);
 
-	bool interpolate = INTERPOLATED_ENGINES.count(engine) > 0;
 	// Create stream of segments
 	while (true)
 	{
@@ -434,10 +431,10 @@ void Slim::filterBlock(StyleStream &stream, const std::string &engine)
 	blockStream.baseFoldLevel(indent + 1);
 	blockStream.foldNext(0);
 
-	if (engine == "css") _css.style(blockStream);
-	else if (engine == "markdown") _markdown.style(blockStream);
-	else if (engine == "ruby") _ruby.style(blockStream);
-	else if (engine == "scss") _scss.style(blockStream);
+	if (!strcmp(engine.word, "css")) _css.style(blockStream);
+	else if (!strcmp(engine.word, "markdown")) _markdown.style(blockStream);
+	else if (!strcmp(engine.word, "ruby")) _ruby.style(blockStream);
+	else if (!strcmp(engine.word, "scss")) _scss.style(blockStream);
 	else while (!blockStream.eof()) blockStream.advanceLine(FILTER);
 
 	stream.foldHeader(firstLine, indent);
@@ -21,6 +21,7 @@
 #include "Html.h"
 #include "Scss.h"
 #include <memory>
+struct Keyword;
 /**Lexer for http://slim-lang.com/
  * Because most of Slim is context sensitive, this implements a near complete parser, rather than
  * just lexing tokens.
@@ -31,11 +32,22 @@ public:
 	Slim();
 
 	virtual void style(StyleStream &stream)override;
-	virtual void SCI_METHOD Lex(unsigned int startPos, int lengthDoc, int initStyle, IDocument *pAccess)override;
+	/**The css filter is plain CSS, see Scss::readsFoldLevels.*/
+	virtual bool readsFoldLevels()const override { return true; }
+	virtual const char * SCI_METHOD DescribeWordListSets()override
+	{
+		return "HTML tag and attribute names\nRuby keywords\nRuby built-in names\nFilter engines";
+	}
+	virtual void setWordList(int n, const std::shared_ptr<const WordList> &list)override;
 private:
-	//line flags
-	static const int SAFE_START = 1;
-
+	enum WordLists
+	{
+		HTML_NAMES = 0,
+		RUBY_KEYWORDS = 1,
+		RUBY_BUILTINS = 2,
+		/**More filter names, styled as FILTER blocks.*/
+		FILTER_ENGINES = 3
+	};
 	enum Style
 	{
 		DEFAULT = Ruby::DEFAULT,
@@ -69,7 +81,8 @@ private:
 
 	void textBlock(StyleStream &stream);
 	void rubyBlock(StyleStream &stream);
-	void filterBlock(StyleStream &stream, const std::string &engine);
+	/**Filter block for one of ENGINES, or an engine from FILTER_ENGINES with an empty word.*/
+	void filterBlock(StyleStream &stream, const Keyword &engine);
 
 	void includeLine(StyleStream &stream);
 	void doctypeLine(StyleStream &stream);